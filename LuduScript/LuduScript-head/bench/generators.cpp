@@ -0,0 +1,79 @@
+#include "generators.h"
+
+// One card of the deck, followed by a top-level update of the running total
+static void appendCard(std::string &s, size_t i)
+{
+    std::string id = std::to_string(i);
+    s += "// card " + id + "\n";
+    s += "obj(\"Card\", " + id + ") {\n";
+    s += "    str(name) { \"card_\" + " + id + " }\n";
+    s += "    num(cost) { " + id + " % 10 }\n";
+    s += "    num(power) {\n        num(base) { cost * 3 }\n        if (base > 10) { base - 2 } elif (base > 5) { base } else { base + 1.5 }\n    }\n";
+    s += "    bool(rare) { " + id + " % 7 == 0 && !(cost < 3) }\n";
+    s += "    str(text) { \"Deal \\\"\" + power + \"\\\" damage\" }\n";
+    s += "}\n";
+    s += "total = total + " + id + "\n";
+}
+
+std::string generateDeck(size_t n)
+{
+    std::string s = "num(total) { 0 }\n";
+    for (size_t i = 1; i <= n; ++i)
+        appendCard(s, i);
+    return s;
+}
+
+std::string generateDeckBytes(size_t targetBytes)
+{
+    std::string s;
+    s.reserve(targetBytes + 512);
+    s += "num(total) { 0 }\n";
+    for (size_t i = 1; s.size() < targetBytes; ++i)
+        appendCard(s, i);
+    return s;
+}
+
+std::string generateNested(size_t depth, size_t n)
+{
+    std::string s = "for(k, 1, " + std::to_string(n) + ") {\n";
+    std::string indent = "    ";
+    std::string prev = "k";
+    for (size_t d = 1; d <= depth; ++d)
+    {
+        std::string v = "v" + std::to_string(d);
+        s += indent + "num(" + v + ") { " + prev + " + 1 }\n";
+        s += indent + "if (" + v + " > 0) {\n";
+        indent += "    ";
+        prev = v;
+    }
+    s += indent + "obj(\"Deep\", k) {\n";
+    s += indent + "    num(level) { " + prev + " }\n";
+    s += indent + "    str(tag) { \"depth_\" + " + std::to_string(depth) + " }\n";
+    s += indent + "}\n";
+    for (size_t d = depth; d > 0; --d)
+    {
+        indent.resize(indent.size() - 4);
+        s += indent + "}\n";
+    }
+    s += "}\n";
+    return s;
+}
+
+std::string generateWideInit(size_t width, size_t n)
+{
+    if (width == 0)
+        width = 1;
+    std::string s;
+    for (size_t i = 1; i <= n; ++i)
+    {
+        s += "obj(\"Wide\", " + std::to_string(i) + ") {\n";
+        s += "    num(score) {\n";
+        s += "        num(a0) { " + std::to_string(i) + " }\n";
+        for (size_t w = 1; w < width; ++w)
+            s += "        num(a" + std::to_string(w) + ") { a" + std::to_string(w - 1) + " * 2 % 1000 + " + std::to_string(w) + " }\n";
+        s += "        a" + std::to_string(width - 1) + " + 0.5\n";
+        s += "    }\n";
+        s += "}\n";
+    }
+    return s;
+}
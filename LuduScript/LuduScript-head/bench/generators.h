@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Synthetic LuduScript sources for the benchmarks 基准测试脚本生成器
+// Every generator scales linearly with its size argument and produces a script that runs cleanly
+// on both engines.
+
+// n obj blocks with literal, arithmetic, string and if/elif init blocks, like a hand-written deck
+std::string generateDeck(size_t n);
+
+// The same deck, with as many cards as it takes to reach targetBytes (lexer_bench, parse_bench)
+std::string generateDeckBytes(size_t targetBytes);
+
+// A for loop of n iterations whose body nests depth if blocks, each declaring a variable read by
+// the next level; the innermost level emits one object
+std::string generateNested(size_t depth, size_t n);
+
+// n objects whose single field is computed by an init block of width chained declarations
+std::string generateWideInit(size_t width, size_t n);
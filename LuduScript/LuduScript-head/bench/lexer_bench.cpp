@@ -0,0 +1,56 @@
+// 词法分析吞吐量基准 (MB/s)
+// 用法: lexer_bench [script.gen] [--repeat N]
+// 不指定脚本时在内存中生成约 8MB 的卡牌脚本; 指定脚本时通过 SourceBuffer 以 mmap 方式加载
+#include "generators.h"
+#include "lexer.h"
+#include "source.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    std::string path;
+    int repeat = 10;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else
+            path = arg;
+    }
+
+    SourceBuffer source;
+    if (path.empty())
+        source = SourceBuffer(generateDeckBytes(8 * 1024 * 1024));
+    else if (!source.load(path))
+    {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return 2;
+    }
+    std::string_view text = source.view();
+
+    // Best of N full passes over the buffer
+    double best = 1e300;
+    size_t tokens = 0;
+    for (int r = 0; r < repeat; ++r)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        Lexer lex(text);
+        size_t count = 0;
+        while (lex.nextToken().kind != TokenKind::END)
+            ++count;
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s);
+        tokens = count;
+    }
+
+    double mb = static_cast<double>(text.size()) / (1024.0 * 1024.0);
+    std::printf("source: %s (%.2f MB%s)\n", path.empty() ? "generated" : path.c_str(), mb, source.mapped() ? ", mmap" : "");
+    std::printf("tokens: %zu\n", tokens);
+    std::printf("lex:    %.2f ms  %.1f MB/s  %.1f Mtok/s\n", best * 1e3, mb / best, static_cast<double>(tokens) / best / 1e6);
+    return 0;
+}
@@ -0,0 +1,314 @@
+// 解释器各阶段基准: 词法、语法、编译缓存加载、执行 (tree / vm)、JSON / 列式输出与加载、端到端运行
+// 用法: luduscript_bench [--scale N] [--repeat N] [--examples <dir>] [--filter <text>]
+//                        [--out <results.json>] [--baseline <results.json>] [--label <text>]
+//                        [--emit-scripts <dir>]
+// 结果以 JSON 写到 --out (默认标准输出), 可读表格写到标准错误; 传入 --baseline 时附加相对上次结果的加速比
+// --emit-scripts 只把生成的脚本写到目录中, 不运行基准
+#include "generators.h"
+#include "columnar.h"
+#include "columnar_reader.h"
+#include "driver.h"
+#include "lexer.h"
+#include "parser.h"
+#include "program_cache.h"
+#include "interpreter.h"
+#include "vm.h"
+#include "source.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef LUDUSCRIPT_EXAMPLES_DIR
+#define LUDUSCRIPT_EXAMPLES_DIR "examples/in"
+#endif
+
+namespace
+{
+    struct Input
+    {
+        std::string name;
+        std::string source;
+    };
+
+    struct Result
+    {
+        std::string stage;
+        std::string input;
+        size_t bytes;
+        int repeat;
+        double best;   // seconds
+        double median; // seconds
+    };
+
+    struct Bench
+    {
+        int repeat = 5;
+        std::string filter;
+        std::vector<Result> results;
+
+        // Times fn repeat times; setup runs before every repetition, outside the clock
+        void run(const std::string &stage, const Input &in, size_t bytes,
+                 const std::function<void()> &fn, const std::function<void()> &setup = {})
+        {
+            std::string name = stage + "/" + in.name;
+            if (!filter.empty() && name.find(filter) == std::string::npos)
+                return;
+            std::vector<double> times;
+            for (int r = 0; r < repeat; ++r)
+            {
+                if (setup)
+                    setup();
+                auto t0 = std::chrono::steady_clock::now();
+                fn();
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+            }
+            std::sort(times.begin(), times.end());
+            results.push_back(Result{stage, in.name, bytes, repeat, times.front(), times[times.size() / 2]});
+        }
+    };
+
+    std::vector<Input> loadExamples(const std::string &dir)
+    {
+        std::vector<std::string> paths;
+        std::error_code ec;
+        for (auto &entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (entry.path().extension() == ".gen")
+                paths.push_back(entry.path().string());
+        }
+        std::sort(paths.begin(), paths.end());
+
+        std::vector<Input> inputs;
+        for (auto &path : paths)
+        {
+            SourceBuffer source;
+            if (source.load(path))
+                inputs.push_back(Input{"examples/" + std::filesystem::path(path).filename().string(), std::string(source.view())});
+        }
+        return inputs;
+    }
+
+    // Lexing, parsing, both engines and serialisation of one script
+    void benchStages(Bench &bench, const Input &in)
+    {
+        std::string_view src = in.source;
+
+        bench.run("lex", in, src.size(), [&]
+                  {
+                      Lexer lex(src);
+                      while (lex.nextToken().kind != TokenKind::END)
+                          ;
+                  });
+        bench.run("parse", in, src.size(), [&]
+                  { Parser(src).parseProgram(); });
+        bench.run("parse_arena", in, src.size(), [&]
+                  { Parser(src, true).parseProgram(); });
+
+        auto program = Parser(src).parseProgram();
+
+        // Rebuilding the AST from its --compile-cache form, in memory
+        std::string cached;
+        uint64_t sourceHash = ProgramCache::hashSource(src);
+        writeProgram(*program, sourceHash, src.size(), cached);
+        bench.run("load_cached", in, src.size(), [&]
+                  { readProgram(cached, sourceHash, src.size()); });
+        std::unique_ptr<Interpreter> interpreter;
+        bench.run("exec_tree", in, src.size(), [&]
+                  { interpreter->execute(program.get()); },
+                  [&]
+                  { interpreter = std::make_unique<Interpreter>(); });
+
+        BytecodeProgram bytecode;
+        bench.run("compile", in, src.size(), [&]
+                  { bytecode = Compiler().compile(*program); });
+        std::unique_ptr<VM> vm;
+        bench.run("exec_vm", in, src.size(), [&]
+                  { vm->execute(bytecode); },
+                  [&]
+                  { vm = std::make_unique<VM>(); });
+
+        // Serialise the objects of one finished run
+        if (!interpreter)
+        {
+            interpreter = std::make_unique<Interpreter>();
+            interpreter->execute(program.get());
+        }
+        size_t outBytes = interpreter->getOutput(false).size();
+        bench.run("json", in, outBytes, [&]
+                  { interpreter->getOutput(false); });
+        bench.run("json_pretty", in, outBytes, [&]
+                  { interpreter->getOutput(true); });
+        bench.run("columnar", in, outBytes, [&]
+                  { encodeColumnar(interpreter->getObjects(), *program->strings); });
+
+        // What a server pays at boot: parsing the JSON output, or mapping the columnar file
+        std::string compact = interpreter->getOutput(false);
+        bench.run("load_json", in, outBytes, [&]
+                  { (void)nlohmann::json::parse(compact); });
+        std::string colPath = (std::filesystem::temp_directory_path() / "luduscript_bench.ldcol").string();
+        {
+            std::string image = encodeColumnar(interpreter->getObjects(), *program->strings);
+            std::ofstream(colPath, std::ios::binary).write(image.data(), static_cast<std::streamsize>(image.size()));
+        }
+        bench.run("load_columnar", in, outBytes, [&]
+                  {
+                      luduscript::columnar::File file;
+                      file.open(colPath);
+                  });
+        std::filesystem::remove(colPath);
+    }
+
+    void benchEndToEnd(Bench &bench, const Input &in, const std::string &engine)
+    {
+        RunOptions opts;
+        opts.engine = engine;
+        bench.run("e2e_" + engine, in, in.source.size(), [&]
+                  {
+                      std::ostringstream out, err;
+                      runScript(in.source, opts, out, err);
+                  });
+    }
+
+    std::string formatTime(double seconds)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f", seconds * 1e3);
+        return buf;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Bench bench;
+    size_t scale = 1;
+    std::string examplesDir = LUDUSCRIPT_EXAMPLES_DIR;
+    std::string outFile, baselineFile, label, emitDir;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc)
+            scale = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--repeat" && i + 1 < argc)
+            bench.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--examples" && i + 1 < argc)
+            examplesDir = argv[++i];
+        else if (arg == "--filter" && i + 1 < argc)
+            bench.filter = argv[++i];
+        else if (arg == "--out" && i + 1 < argc)
+            outFile = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (arg == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else if (arg == "--emit-scripts" && i + 1 < argc)
+            emitDir = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Input> generated = {
+        {"deck_" + std::to_string(20000 * scale), generateDeck(20000 * scale)},
+        {"nested_32x" + std::to_string(5000 * scale), generateNested(32, 5000 * scale)},
+        {"wide_256x" + std::to_string(1000 * scale), generateWideInit(256, 1000 * scale)},
+    };
+
+    if (!emitDir.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(emitDir, ec);
+        for (auto &in : generated)
+        {
+            std::string path = (std::filesystem::path(emitDir) / (in.name + ".gen")).string();
+            std::ofstream ofs(path, std::ios::binary);
+            if (!(ofs << in.source))
+            {
+                std::fprintf(stderr, "Cannot write to %s\n", path.c_str());
+                return 3;
+            }
+        }
+        return 0;
+    }
+    std::vector<Input> examples = loadExamples(examplesDir);
+
+    for (auto &in : generated)
+        benchStages(bench, in);
+    for (auto &in : examples)
+    {
+        benchEndToEnd(bench, in, "tree");
+        benchEndToEnd(bench, in, "vm");
+    }
+    for (auto &in : generated)
+        benchEndToEnd(bench, in, "tree");
+
+    // Earlier results by name, for the speedup column
+    std::map<std::string, double> baseline;
+    if (!baselineFile.empty())
+    {
+        std::ifstream ifs(baselineFile);
+        try
+        {
+            nlohmann::json old = nlohmann::json::parse(ifs);
+            for (auto &r : old.at("results"))
+                baseline[r.at("name").get<std::string>()] = r.at("best_ms").get<double>();
+        }
+        catch (const std::exception &ex)
+        {
+            std::fprintf(stderr, "Cannot read baseline %s: %s\n", baselineFile.c_str(), ex.what());
+            return 1;
+        }
+    }
+
+    nlohmann::json doc;
+    doc["label"] = label;
+    doc["scale"] = scale;
+    doc["repeat"] = bench.repeat;
+    doc["results"] = nlohmann::json::array();
+    std::fprintf(stderr, "%-36s %12s %12s %12s %10s%s\n", "benchmark", "bytes", "best ms", "median ms", "MB/s", baseline.empty() ? "" : "   speedup");
+    for (auto &r : bench.results)
+    {
+        std::string name = r.stage + "/" + r.input;
+        double mbps = static_cast<double>(r.bytes) / (1024.0 * 1024.0) / r.best;
+        nlohmann::json j;
+        j["name"] = name;
+        j["stage"] = r.stage;
+        j["input"] = r.input;
+        j["bytes"] = r.bytes;
+        j["best_ms"] = r.best * 1e3;
+        j["median_ms"] = r.median * 1e3;
+        j["mb_per_s"] = mbps;
+        doc["results"].push_back(std::move(j));
+
+        std::fprintf(stderr, "%-36s %12zu %12s %12s %10.1f", name.c_str(), r.bytes, formatTime(r.best).c_str(), formatTime(r.median).c_str(), mbps);
+        auto it = baseline.find(name);
+        if (it != baseline.end())
+            std::fprintf(stderr, "   %6.2fx", it->second / (r.best * 1e3));
+        std::fprintf(stderr, "\n");
+    }
+
+    if (outFile.empty())
+    {
+        std::cout << doc.dump(2) << std::endl;
+        return 0;
+    }
+    std::ofstream ofs(outFile);
+    if (!ofs)
+    {
+        std::fprintf(stderr, "Cannot write to %s\n", outFile.c_str());
+        return 3;
+    }
+    ofs << doc.dump(2) << std::endl;
+    return 0;
+}
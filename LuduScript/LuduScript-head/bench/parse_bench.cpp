@@ -0,0 +1,113 @@
+// 语法分析吞吐量基准 (MB/s)
+// 用法: parse_bench [script.gen | 目录]... [--repeat N] [--arena]
+// 依次解析每个脚本（目录中的全部 .gen）以及内存中生成的约 8MB 卡牌脚本, 取 N 次中的最好成绩
+#include "generators.h"
+#include "parser.h"
+#include "source.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Best-of-N parse time in seconds; -1 if the script does not parse
+static double timeParse(std::string_view src, bool arena, int repeat, std::string &error)
+{
+    double best = 1e300;
+    for (int r = 0; r < repeat; ++r)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        try
+        {
+            Parser parser(src, arena);
+            auto program = parser.parseProgram();
+        }
+        catch (const std::exception &ex)
+        {
+            error = ex.what();
+            return -1;
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+static void report(const std::string &name, size_t bytes, double seconds)
+{
+    double mb = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    std::printf("%-40s %10zu B %10.3f ms %9.1f MB/s\n", name.c_str(), bytes, seconds * 1e3, mb / seconds);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    int repeat = 10;
+    bool arena = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--arena")
+            arena = true;
+        else
+            paths.push_back(arg);
+    }
+
+    std::vector<std::string> scripts;
+    for (auto &p : paths)
+    {
+        std::error_code ec;
+        if (std::filesystem::is_directory(p, ec))
+        {
+            std::vector<std::string> found;
+            for (auto &entry : std::filesystem::directory_iterator(p, ec))
+            {
+                if (entry.path().extension() == ".gen")
+                    found.push_back(entry.path().string());
+            }
+            std::sort(found.begin(), found.end());
+            scripts.insert(scripts.end(), found.begin(), found.end());
+        }
+        else
+            scripts.push_back(p);
+    }
+
+    std::printf("mode: %s, best of %d\n", arena ? "arena" : "heap", repeat);
+    size_t totalBytes = 0;
+    double totalSeconds = 0;
+    for (auto &path : scripts)
+    {
+        SourceBuffer source;
+        if (!source.load(path))
+        {
+            std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+            return 2;
+        }
+        std::string error;
+        double s = timeParse(source.view(), arena, repeat, error);
+        if (s < 0)
+        {
+            std::printf("%-40s %s\n", path.c_str(), error.c_str());
+            continue;
+        }
+        report(path, source.view().size(), s);
+        totalBytes += source.view().size();
+        totalSeconds += s;
+    }
+    if (!scripts.empty() && totalSeconds > 0)
+        report("(files total)", totalBytes, totalSeconds);
+
+    std::string generated = generateDeckBytes(8 * 1024 * 1024);
+    std::string error;
+    double s = timeParse(generated, arena, std::max(1, repeat / 2), error);
+    if (s < 0)
+    {
+        std::fprintf(stderr, "generated script: %s\n", error.c_str());
+        return 1;
+    }
+    report("(generated deck)", generated.size(), s);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Monotonic bump-pointer arena 单调分配内存池
+// Memory is handed out from large blocks and only released all at once when the arena dies.
+class Arena
+{
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *cur = nullptr;
+    size_t left = 0;
+    size_t nextBlockSize;
+    size_t used = 0; // bytes handed out, including alignment padding
+
+    void *grow(size_t size, size_t align);
+
+public:
+    explicit Arena(size_t firstBlockSize = 64 * 1024) : nextBlockSize(firstBlockSize) {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t align)
+    {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+        if (pad + size > left)
+            return grow(size, align);
+        char *p = cur + pad;
+        cur = p + size;
+        left -= pad + size;
+        used += pad + size;
+        return p;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t blockCount() const { return blocks.size(); }
+};
@@ -1,33 +1,102 @@
 #pragma once
 
+#include <iosfwd>
 #include <memory>
 #include <vector>
 #include <string>
 #include <optional>
+#include "arena.h"
+#include "interner.h"
 
 using ll = long long;
 
+// Node kind tag 节点类型标签
+// Set by every constructor so the interpreter can dispatch with a switch instead of dynamic_cast
+enum class NodeKind : uint8_t
+{
+    // 表达式
+    LITERAL,
+    IDENT,
+    UNARY,
+    BINARY,
+    CALL,
+    ACCESS,
+    // 语句
+    PROGRAM,
+    EXPR_STMT,
+    ASSIGN,
+    DECL,
+    IF,
+    FOR,
+    OBJ,
+    BREAK,
+    CONTINUE
+};
+
+// Resolved variable slot 变量槽位 (scope depth + index in that scope's frame)
+struct Slot
+{
+    int depth;
+    int index;
+};
+
+// Where a name may live at runtime, filled in by the Resolver
+// A name can be created in several enclosing scopes, so lookups take the first candidate that is set
+struct VarBinding
+{
+    std::vector<Slot> candidates; // innermost first
+    int own = -1;                 // slot in the current scope used when the variable is created, -1 if none
+};
+
 // Base AST node
 struct Node
 {
+    NodeKind kind;
+    bool inArena = false; // placement-allocated in a Program's arena
     int line;
-    explicit Node(int l = 1) : line(l) {}
+    Node(NodeKind k, int l = 1) : kind(k), line(l) {}
     virtual ~Node() = default;
 };
 
+// Owning node pointer 节点指针
+// Heap nodes are deleted; arena nodes are only destroyed, the arena releases their memory
+struct NodeDeleter
+{
+    void operator()(Node *n) const
+    {
+        if (n->inArena)
+            n->~Node();
+        else
+            delete n;
+    }
+};
+template <class T>
+using NodePtr = std::unique_ptr<T, NodeDeleter>;
+
+// Creates a node on the heap, or in arena if one is given
+template <class T, class... Args>
+NodePtr<T> makeNode(Arena *arena, Args &&...args)
+{
+    if (!arena)
+        return NodePtr<T>(new T(std::forward<Args>(args)...));
+    T *n = new (arena->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    n->inArena = true;
+    return NodePtr<T>(n);
+}
+
 // Expression nodes 表达式节点
 struct Expr : Node
 {
-    explicit Expr(int l = 1) : Node(l) {}
+    Expr(NodeKind k, int l = 1) : Node(k, l) {}
 };
-using ExprPtr = std::unique_ptr<Expr>;
+using ExprPtr = NodePtr<Expr>;
 
 // Statement nodes 语句节点
 struct Stmt : Node
 {
-    explicit Stmt(int l = 1) : Node(l) {}
+    Stmt(NodeKind k, int l = 1) : Node(k, l) {}
 };
-using StmtPtr = std::unique_ptr<Stmt>;
+using StmtPtr = NodePtr<Stmt>;
 
 // Literal expressions 字面量表达式
 struct LiteralExpr : Expr
@@ -38,43 +107,73 @@ struct LiteralExpr : Expr
         FLOAT,   // 浮点数类型，使用dval
         STRING,
         BOOL
-    } kind;
+    } litKind;
 
     union
     {
         ll ival;     // 整数值
         double dval; // 浮点数值
     };
-    std::string sval;
+    Symbol sval; // 字符串值, interned
     bool bval;
 
     LiteralExpr(ll v, int l);     // 整数构造函数
     LiteralExpr(double d, int l); // 浮点数构造函数
-    LiteralExpr(std::string s, int l);
+    LiteralExpr(Symbol s, int l);
     LiteralExpr(bool b, int l);
 };
 
 // Identifier expressions 标识符表达式
 struct IdentExpr : Expr
 {
-    std::string name;
-    IdentExpr(std::string n, int l);
+    Symbol name;
+    VarBinding binding;
+    IdentExpr(Symbol n, int l);
+};
+
+// Operators 运算符
+// Resolved from the token by the parser; the order of BinaryOp indexes the ops::binaryTable jump table
+enum class UnaryOp : uint8_t
+{
+    NEG, // -
+    NOT  // !
 };
 
+enum class BinaryOp : uint8_t
+{
+    ADD, // +
+    SUB, // -
+    MUL, // *
+    DIV, // /
+    MOD, // %
+    EQ,  // ==
+    NEQ, // !=
+    LT,  // <
+    GT,  // >
+    LE,  // <=
+    GE,  // >=
+    AND, // &&, short-circuit; must stay after every eager operator
+    OR,  // ||, short-circuit
+    COUNT
+};
+
+const char *opText(UnaryOp op);
+const char *opText(BinaryOp op);
+
 // Unary expressions 一元表达式(操作符 + 右操作数)
 struct UnaryExpr : Expr
 {
-    std::string op;
+    UnaryOp op;
     ExprPtr rhs;
-    UnaryExpr(std::string o, ExprPtr r, int l);
+    UnaryExpr(UnaryOp o, ExprPtr r, int l);
 };
 
 // Binary expressions 二元表达式(左操作数 + 操作符 + 右操作数)
 struct BinaryExpr : Expr
 {
-    std::string op;
+    BinaryOp op;
     ExprPtr lhs, rhs;
-    BinaryExpr(ExprPtr l, std::string o, ExprPtr r, int ln);
+    BinaryExpr(ExprPtr l, BinaryOp o, ExprPtr r, int ln);
 };
 
 // Function call expressions 函数调用表达式(函数名 + 实参列表) TODO 这个似乎解释器还不支持
@@ -89,14 +188,18 @@ struct CallExpr : Expr
 struct AccessExpr : Expr
 {
     ExprPtr target;
-    std::string member;
-    AccessExpr(ExprPtr t, std::string m, int l);
+    Symbol member;
+    AccessExpr(ExprPtr t, Symbol m, int l);
 };
 
 // Program (root node) 程序(根节点)
 struct Program : Node
 {
+    std::unique_ptr<Arena> arena; // owns the nodes in arena mode; declared first so it outlives stmts
     std::vector<StmtPtr> stmts;
+    int globalSlots = 0;
+    std::vector<Symbol> globalNames;      // variable name of each global slot
+    std::shared_ptr<StringTable> strings; // names and string literals used by the program
     Program();
 };
 
@@ -110,9 +213,10 @@ struct ExprStmt : Stmt
 // Assignment statement 赋值语句(变量名 + 表达式)
 struct AssignStmt : Stmt
 {
-    std::string name;
+    Symbol name;
     ExprPtr expr;
-    AssignStmt(std::string n, ExprPtr e, int l);
+    VarBinding binding;
+    AssignStmt(Symbol n, ExprPtr e, int l);
 };
 
 // Declaration statement 声明语句(类型 + 变量名 + 初始化表达式)
@@ -121,11 +225,14 @@ struct AssignStmt : Stmt
 struct DeclStmt : Stmt
 {
     std::string type; // "num", "str", "bool"
-    std::string name;
+    Symbol name;
     std::optional<ExprPtr> init;
     std::vector<StmtPtr> initBlock; // For statement block initialization
-    DeclStmt(std::string t, std::string n, std::optional<ExprPtr> i, int l);
-    DeclStmt(std::string t, std::string n, std::vector<StmtPtr> block, int l);
+    int slot = -1;                  // variable slot in the current scope, -1 inside an object
+    int initSlots = 0;              // frame size of initBlock
+    VarBinding result;              // last variable declared in initBlock, the block's fallback value
+    DeclStmt(std::string t, Symbol n, std::optional<ExprPtr> i, int l);
+    DeclStmt(std::string t, Symbol n, std::vector<StmtPtr> block, int l);
 };
 
 // If statement 条件语句(条件 + 语句块 + 可选的elif语句块 + 可选的else语句块)
@@ -135,25 +242,31 @@ struct IfStmt : Stmt
     std::vector<StmtPtr> thenBody;
     std::vector<std::pair<ExprPtr, std::vector<StmtPtr>>> elifs;
     std::vector<StmtPtr> elseBody;
+    int thenSlots = 0;
+    std::vector<int> elifSlots;
+    int elseSlots = 0;
     IfStmt(ExprPtr c, int l);
 };
 
 // For statement 循环语句(迭代变量 + 迭代范围 + 语句块)
 struct ForStmt : Stmt
 {
-    std::string iter;
+    Symbol iter;
     std::vector<ExprPtr> args; // 1~3 args: total or start,end or start,end,step
     std::vector<StmtPtr> body;
-    ForStmt(std::string it, int l);
+    int iterSlot = 0;
+    int bodySlots = 0; // the body runs in the loop scope together with the iterator
+    ForStmt(Symbol it, int l);
 };
 
 // Object statement 对象语句(类名 + 可选的对象ID + 语句块)
 struct ObjStmt : Stmt
 {
-    std::string className;
+    Symbol className;
     ExprPtr idExpr;
     std::vector<StmtPtr> body;
-    ObjStmt(std::string c, ExprPtr id, int l);
+    int bodySlots = 0;
+    ObjStmt(Symbol c, ExprPtr id, int l);
 };
 
 // Break statement 跳出语句
@@ -168,4 +281,7 @@ struct ContinueStmt : Stmt
 {
     std::vector<StmtPtr> body; // 继续时执行的语句块
     ContinueStmt(std::vector<StmtPtr> b, int l);
-};
\ No newline at end of file
+};
+
+// Writes an indented, one-node-per-line listing of the program (--dump-ast)
+void dumpAst(const Program &program, std::ostream &out);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "driver.h"
+#include <iosfwd>
+#include <string>
+
+// Batch mode 批量模式
+// Runs many scripts in one process on a shared thread pool. The input is either a directory
+// (every *.gen file, in name order) or a manifest file listing one script per line, relative
+// to the manifest; blank lines and lines starting with # are skipped. Each script gets its own
+// Parser/Interpreter and writes <outDir>/<name>.json.
+struct BatchOptions
+{
+    std::string input;          // directory or manifest
+    std::string outDir = "output";
+    std::string summaryFile;    // optional JSON summary of timings and errors
+    unsigned threads = 1;
+};
+
+// Prints one line per script and a total to out; returns 0 when every script succeeded
+int runBatch(const BatchOptions &batch, const RunOptions &opts, std::ostream &out, std::ostream &err);
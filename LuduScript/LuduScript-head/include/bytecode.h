@@ -0,0 +1,143 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bytecode opcodes 字节码操作码
+enum class OpCode : uint8_t
+{
+    CONST,         // push consts[a]
+    LOAD,          // push variable refs[a], falling back to the object field / field name
+    STORE,         // pop and assign to refs[a]
+    DECL,          // pop and declare refs[a] (object field or variable in the current scope)
+    LOAD_IF_SET,   // replace the top of stack with variable refs[a] if it is set
+    POP,
+    REPLACE,       // pop and overwrite the new top of stack
+    NEG,
+    NOT,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    EQ,
+    NEQ,
+    LT,
+    GT,
+    LE,
+    GE,
+    TO_BOOL,       // replace the top of stack with its truth value
+    JUMP,          // pc = a
+    JUMP_IF_FALSE, // pop; if false pc = a
+    AND_JUMP,      // && left operand: make the top a bool; if false pc = a (keeping it), else pop
+    OR_JUMP,       // || left operand: make the top a bool; if true pc = a (keeping it), else pop
+    PUSH_SCOPE,    // push a scope frame with a slots
+    POP_SCOPE,
+    FOR_PREP,      // pop a (1~3) loop bounds and start a loop
+    FOR_NEXT,      // write the counter to slot a of the current scope, or finish the loop at b
+    FOR_END,       // drop the loop state
+    OBJ_BEGIN,     // start object of class strings[a]
+    OBJ_ID,        // pop the object id
+    OBJ_END,       // emit the current object
+    OBJ_ABORT,     // drop the current object (break/continue out of an obj body)
+    FAIL,          // throw messages[a]
+    HALT
+};
+
+// Single instruction 指令
+struct Instr
+{
+    OpCode op;
+    int32_t a;
+    int32_t b;
+    int line;
+};
+
+// Variable reference, flattened from the Resolver's VarBinding
+// 变量可能在若干外层作用域中声明, 运行时按由内到外的顺序取第一个已赋值的槽位
+struct VarRef
+{
+    Symbol name;
+    int ownSlot;     // slot in the innermost scope used when the variable is created, or -1
+    uint32_t first;  // candidates[first, first + count), innermost first
+    uint32_t count;
+};
+
+// Instruction range of an expression statement; runtime errors inside it carry the statement line
+struct ErrorRange
+{
+    uint32_t begin;
+    uint32_t end;
+    int line;
+};
+
+// Compiled program 编译后的程序
+struct BytecodeProgram
+{
+    std::vector<Instr> code;
+    std::vector<Value> consts;
+    std::vector<std::string> messages; // FAIL error messages
+    std::shared_ptr<const StringTable> strings;
+    std::vector<VarRef> refs;
+    std::vector<Slot> candidates;
+    std::vector<ErrorRange> errorRanges;
+    int globalSlots = 0;
+};
+
+// Lowers a Program into a flat BytecodeProgram
+class Compiler
+{
+private:
+    struct Loop
+    {
+        int scopeDepth;    // scopeDepth inside the loop
+        int pending;       // pending values at loop entry
+        int objects;       // objectDepth at loop entry
+        size_t continueTarget;
+        std::vector<size_t> breaks;
+    };
+
+    BytecodeProgram out;
+    std::vector<Loop> loops;
+    std::unordered_map<std::string, int> messageIds;
+    int scopeDepth = 0;  // scope frames open at the current instruction
+    int objectDepth = 0; // obj bodies enclosing the current statement
+    int pending = 0;     // init block results kept on the operand stack
+
+    size_t emit(OpCode op, int a = 0, int b = 0, int line = 0);
+    int here() const;
+    int addConst(Value v);
+    int addMessage(const std::string &msg);
+    int addRef(Symbol name, const VarBinding &binding, int ownSlot);
+
+    void openScope(int slots, int line);
+    void closeScope(int line);
+    void emitUnwind(const Loop &loop, int line);
+
+    // Expression compiling
+    void compileExpr(Expr *e);
+
+    // Statement compiling
+    void compileStmt(Stmt *s);
+    void compileBody(const std::vector<StmtPtr> &body);
+    void compileBlock(const std::vector<StmtPtr> &body, int slots, int line);
+    void compileDecl(DeclStmt *ds);
+    void compileIf(IfStmt *is);
+    void compileFor(ForStmt *fs);
+    void compileObj(ObjStmt *os);
+    void compileLoopExit(const std::vector<StmtPtr> &body, bool isBreak, int line);
+
+    // Value-producing blocks of declaration initializers
+    void compileIfWithReturn(IfStmt *is);
+    void compileBlockWithReturn(const std::vector<StmtPtr> &body, int slots, int line);
+
+public:
+    Compiler() = default;
+
+    BytecodeProgram compile(const Program &program);
+};
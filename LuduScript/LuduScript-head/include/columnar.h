@@ -0,0 +1,13 @@
+#pragma once
+
+#include "interpreter.h"
+#include <string>
+#include <vector>
+
+// Columnar binary output 列式二进制输出
+// Encodes the generated objects grouped by "class", one fixed-width column per field with strings
+// dictionary-encoded, in the layout documented in columnar_reader.h. Servers map the file with
+// that header instead of parsing the JSON output on every boot.
+// Classes appear in the order of their first object; the order of objects across classes is
+// not kept. Returns the file image.
+std::string encodeColumnar(const ObjectList &objects, const StringTable &strings);
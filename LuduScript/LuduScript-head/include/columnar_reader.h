@@ -0,0 +1,364 @@
+#pragma once
+
+// Reader for the columnar output of luduscript --format=columnar 列式输出读取器
+// Header-only and independent of the interpreter: a game server copies this one file, maps the
+// .ldcol file and reads cards by (class, field, row) with no parsing. Tables and columns are
+// located once in open(); every value access is an array index into the mapping.
+//
+//     luduscript::columnar::File deck;
+//     if (!deck.open("poker.ldcol")) { ... deck.error() ... }
+//     const auto *cards = deck.find("Card");
+//     const auto *suit = cards->find("suit"), *rank = cards->find("rank_value");
+//     for (size_t r = 0; r < cards->rows(); ++r)
+//         use(suit->str(r), rank->i64(r));
+//
+// File layout (native byte order, every section 8-byte aligned):
+//   FileHeader
+//   string dictionary: u64 offsets[stringCount + 1] into the UTF-8 bytes that follow
+//   ClassEntry[classCount]
+//   per class: ColumnEntry[columnCount], then the column arrays
+// A class holds the objects of one "class" value in output order; its columns are the other
+// fields in first-write order, starting with "id". Each column stores one fixed-width value per
+// row: I64 int64, F64 double (integers included when the field also holds floats), BOOL u8,
+// STR u32 dictionary id. A field mixing numbers, strings and bools is ANY: a u8 ColumnType tag
+// per row plus an 8-byte payload (int64, double bits, bool or string id). Rows lacking the field are cleared in the presence bitmap (bit r of byte r / 8)
+// and hold zero; columns every row has carry no bitmap.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace luduscript::columnar
+{
+    constexpr char kMagic[4] = {'L', 'D', 'C', 'L'};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kByteOrder = 0x01020304; // reads differently on a host of the other endianness
+
+    enum class ColumnType : uint8_t
+    {
+        I64,
+        F64,
+        BOOL,
+        STR,
+        ANY
+    };
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t classCount;
+        uint64_t stringCount;
+        uint64_t stringsOffset;
+        uint64_t classesOffset;
+    };
+
+    struct ClassEntry
+    {
+        uint32_t name; // dictionary id
+        uint32_t columnCount;
+        uint64_t rows;
+        uint64_t columnsOffset;
+    };
+
+    struct ColumnEntry
+    {
+        uint32_t name; // dictionary id
+        ColumnType type;
+        uint8_t reserved[3];
+        uint64_t dataOffset;
+        uint64_t presentOffset; // 0 when every row has the field
+        uint64_t tagsOffset;    // ANY columns only
+    };
+
+    static_assert(sizeof(FileHeader) == 40 && sizeof(ClassEntry) == 24 && sizeof(ColumnEntry) == 32,
+                  "columnar structs must match the file layout");
+
+    class File;
+
+    // One field of a class, a fixed-width array over its rows
+    class Column
+    {
+    public:
+        std::string_view name() const { return name_; }
+        ColumnType type() const { return type_; }
+        size_t size() const { return rows; }
+
+        bool has(size_t row) const { return !present || (present[row / 8] >> (row % 8)) & 1; }
+        // Type of one value; differs from type() only in ANY columns
+        ColumnType typeAt(size_t row) const { return tags ? static_cast<ColumnType>(tags[row]) : type_; }
+
+        int64_t i64(size_t row) const
+        {
+            ColumnType t = typeAt(row);
+            return t == ColumnType::F64 ? static_cast<int64_t>(f64(row)) : t == ColumnType::I64 ? load<int64_t>(row) : 0;
+        }
+        double f64(size_t row) const
+        {
+            ColumnType t = typeAt(row);
+            return t == ColumnType::F64 ? load<double>(row) : t == ColumnType::I64 ? static_cast<double>(load<int64_t>(row)) : 0.0;
+        }
+        bool boolean(size_t row) const
+        {
+            if (typeAt(row) != ColumnType::BOOL)
+                return false;
+            return tags ? load<uint64_t>(row) != 0 : data[row] != 0;
+        }
+        std::string_view str(size_t row) const;
+
+        // The raw array, for bulk copies: int64_t / double for I64 / F64 columns, uint8_t for BOOL,
+        // uint32_t dictionary ids for STR and 8-byte payloads for ANY
+        const void *raw() const { return data; }
+
+    private:
+        friend class File;
+        const File *file = nullptr;
+        std::string_view name_;
+        ColumnType type_ = ColumnType::I64;
+        size_t rows = 0;
+        const unsigned char *data = nullptr;
+        const unsigned char *present = nullptr;
+        const unsigned char *tags = nullptr;
+
+        size_t width() const
+        {
+            return tags ? 8 : type_ == ColumnType::BOOL ? 1 : type_ == ColumnType::STR ? 4 : 8;
+        }
+        template <class T>
+        T load(size_t row) const
+        {
+            T v;
+            std::memcpy(&v, data + row * width(), sizeof(T));
+            return v;
+        }
+    };
+
+    // The objects of one class
+    class Table
+    {
+    public:
+        std::string_view name() const { return name_; }
+        size_t rows() const { return rows_; }
+        const std::vector<Column> &columns() const { return columns_; }
+        const Column *find(std::string_view field) const
+        {
+            for (auto &c : columns_)
+                if (c.name() == field)
+                    return &c;
+            return nullptr;
+        }
+
+    private:
+        friend class File;
+        std::string_view name_;
+        size_t rows_ = 0;
+        std::vector<Column> columns_;
+    };
+
+    class File
+    {
+    public:
+        File() = default;
+        File(const File &) = delete;
+        File &operator=(const File &) = delete;
+        ~File() { close(); }
+
+        // Maps path and locates its tables; false with error() set if the file is missing or damaged
+        bool open(const std::string &path)
+        {
+            close();
+            if (!map(path))
+                return fail("Cannot open " + path);
+            return index() || fail(path + " is not a valid columnar file (" + err + ")");
+        }
+
+        const std::string &error() const { return err; }
+        const std::vector<Table> &tables() const { return tables_; }
+        const Table *find(std::string_view className) const
+        {
+            for (auto &t : tables_)
+                if (t.name() == className)
+                    return &t;
+            return nullptr;
+        }
+
+        size_t stringCount() const { return strings; }
+        std::string_view string(uint64_t id) const
+        {
+            if (id >= strings)
+                return {};
+            uint64_t b = offset(id), e = offset(id + 1);
+            return std::string_view(reinterpret_cast<const char *>(stringBytes + b), e - b);
+        }
+
+    private:
+        const unsigned char *base = nullptr;
+        size_t size = 0;
+        void *mapping = nullptr;
+        std::vector<unsigned char> owned; // platforms without mmap
+        std::string err;
+        uint64_t strings = 0;
+        const unsigned char *stringOffsets = nullptr;
+        const unsigned char *stringBytes = nullptr;
+        std::vector<Table> tables_;
+
+        bool bad(const std::string &why)
+        {
+            err = why;
+            return false;
+        }
+
+        bool fail(const std::string &msg)
+        {
+            close();
+            err = msg;
+            return false;
+        }
+
+        void close()
+        {
+#if !defined(_WIN32)
+            if (mapping)
+                munmap(mapping, size);
+#endif
+            mapping = nullptr;
+            base = nullptr;
+            size = 0;
+            owned.clear();
+            tables_.clear();
+            strings = 0;
+        }
+
+        bool map(const std::string &path)
+        {
+#if !defined(_WIN32)
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+            {
+                void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    ::close(fd);
+                    mapping = p;
+                    base = static_cast<const unsigned char *>(p);
+                    size = static_cast<size_t>(st.st_size);
+                    return true;
+                }
+            }
+            ::close(fd);
+#endif
+            std::ifstream ifs(path, std::ios::binary);
+            if (!ifs)
+                return false;
+            owned.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            base = owned.data();
+            size = owned.size();
+            return true;
+        }
+
+        uint64_t offset(uint64_t i) const
+        {
+            uint64_t v;
+            std::memcpy(&v, stringOffsets + i * 8, 8);
+            return v;
+        }
+
+        // [off, off + count * width) lies inside the file
+        bool inside(uint64_t off, uint64_t count, uint64_t width) const
+        {
+            return off <= size && (width == 0 || count <= (size - off) / width);
+        }
+
+        bool index()
+        {
+            FileHeader h;
+            if (size < sizeof(h))
+                return bad("truncated header");
+            std::memcpy(&h, base, sizeof(h));
+            if (std::memcmp(h.magic, kMagic, 4) != 0)
+                return bad("bad magic");
+            if (h.byteOrder != kByteOrder)
+                return bad("written on a host of the other byte order");
+            if (h.version != kVersion)
+                return bad("unsupported version " + std::to_string(h.version));
+
+            // stringCount + 1 offsets; the count is checked on its own first so the + 1 cannot wrap
+            if (h.stringsOffset > size || h.stringCount >= (size - h.stringsOffset) / 8)
+                return bad("truncated string dictionary");
+            strings = h.stringCount;
+            stringOffsets = base + h.stringsOffset;
+            stringBytes = stringOffsets + (strings + 1) * 8;
+            if (!inside(stringBytes - base, offset(strings), 1))
+                return bad("truncated string dictionary");
+            for (uint64_t i = 0; i < strings; ++i)
+                if (offset(i) > offset(i + 1))
+                    return bad("bad string offsets");
+
+            if (!inside(h.classesOffset, h.classCount, sizeof(ClassEntry)))
+                return bad("truncated class table");
+            for (uint32_t c = 0; c < h.classCount; ++c)
+            {
+                ClassEntry ce;
+                std::memcpy(&ce, base + h.classesOffset + c * sizeof(ClassEntry), sizeof(ce));
+                if (ce.name >= strings || !inside(ce.columnsOffset, ce.columnCount, sizeof(ColumnEntry)))
+                    return bad("bad class entry");
+                Table &t = tables_.emplace_back();
+                t.name_ = string(ce.name);
+                t.rows_ = static_cast<size_t>(ce.rows);
+                for (uint32_t k = 0; k < ce.columnCount; ++k)
+                {
+                    ColumnEntry e;
+                    std::memcpy(&e, base + ce.columnsOffset + k * sizeof(ColumnEntry), sizeof(e));
+                    if (e.name >= strings || e.type > ColumnType::ANY)
+                        return bad("bad column entry");
+                    Column &col = t.columns_.emplace_back();
+                    col.file = this;
+                    col.name_ = string(e.name);
+                    col.type_ = e.type;
+                    col.rows = t.rows_;
+                    if (e.type == ColumnType::ANY)
+                    {
+                        if (!inside(e.tagsOffset, ce.rows, 1))
+                            return bad("truncated column");
+                        col.tags = base + e.tagsOffset;
+                    }
+                    if (!inside(e.dataOffset, ce.rows, col.width()))
+                        return bad("truncated column");
+                    col.data = base + e.dataOffset;
+                    if (e.presentOffset != 0)
+                    {
+                        if (!inside(e.presentOffset, ce.rows / 8 + (ce.rows % 8 != 0), 1))
+                            return bad("truncated column");
+                        col.present = base + e.presentOffset;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+
+    inline std::string_view Column::str(size_t row) const
+    {
+        if (typeAt(row) != ColumnType::STR)
+            return {};
+        if (tags)
+            return file->string(load<uint64_t>(row));
+        return file->string(load<uint32_t>(row));
+    }
+}
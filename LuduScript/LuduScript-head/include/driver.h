@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+// Options of one script run 运行选项
+struct RunOptions
+{
+    bool pretty = false;
+    std::string format = "json"; // "json" or "columnar" (binary, needs outputFile)
+    std::string fieldOrder = "sorted"; // JSON field order: "sorted" by key or "declared" as in the script
+    std::string outputFile;
+    std::string engine = "tree";
+    bool arena = false;
+    std::string stream; // "" (buffered), "array" or "ndjson"
+    bool dumpAst = false;
+    unsigned jobs = 1; // threads for independent top-level loops (tree engine)
+    std::string profile; // flame graph JSON path; empty disables statement profiling
+    std::string cacheFile; // incremental execution cache (tree engine); empty runs everything
+    std::string compileCache; // directory of compiled programs keyed by source hash; empty always parses
+};
+
+// Parses, optimises and runs one script. The JSON goes to opts.outputFile, or to out when
+// no file is given (columnar output always goes to the file); progress notes go to out and errors to err. With opts.profile the
+// per-statement table goes to err, even when the script fails.
+// Returns 0 on success, 1 for script errors and 3 when the output file cannot be written.
+int runScript(std::string_view source, const RunOptions &opts, std::ostream &out, std::ostream &err);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Incremental execution cache 增量执行缓存
+// A top-level statement can only observe and change the global variables it names, and its other
+// effect is the objects it emits. The cache maps (statement hash, hash of the named globals on
+// entry) to those objects and the named globals on exit; on a rerun of an edited script every
+// statement whose key is unchanged is replayed instead of executed, including statements after
+// the edit that do not depend on it. Statements that fail are never cached.
+//
+// File layout (native byte order): "LDXC", u32 format, then per entry u64 statement hash,
+// u64 state hash, u32 length, u64 checksum and the entry as compact JSON [globals, [objects...]],
+// each object an array of [key, value] pairs so replayed objects keep their field order. Entries
+// are only decoded when they are hit; a checksum mismatch anywhere discards the whole file, since
+// a damaged entry can still be valid JSON.
+class ExecCache
+{
+public:
+    struct Entry
+    {
+        json globals = json::object(); // named globals set after the statement
+        ObjectList objects;             // objects emitted by the statement, in order
+    };
+
+    // Entries of a previous run; a missing, damaged or outdated file is an empty cache
+    void load(const std::string &path);
+    // Keeps only the entries looked up or stored by this run, so edits do not pile up stale
+    // entries; nothing is written when the run changed nothing. The file is replaced through a
+    // temporary and a rename, as ProgramCache does
+    bool save(const std::string &path) const;
+
+    // Object keys are looked up in strings; an entry naming a key the program lacks is a miss
+    bool find(uint64_t stmt, uint64_t state, const StringTable &strings, Entry &out);
+    void store(uint64_t stmt, uint64_t state, const StringTable &strings, const Entry &entry);
+
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+
+    // Structural hash of a statement with names and literals by content and source lines ignored.
+    // names receives every variable name the statement mentions, each once.
+    static uint64_t hashStmt(const Stmt *s, const StringTable &strings, std::vector<Symbol> &names);
+    // Hash of one global variable; a state hash is the sum over the set variables it covers
+    static uint64_t hashGlobal(std::string_view name, const Value &v);
+
+private:
+    struct Cached
+    {
+        std::string blob;
+        bool used = false;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const std::pair<uint64_t, uint64_t> &k) const
+        {
+            return static_cast<size_t>(k.first ^ (k.second * 0x9E3779B97F4A7C15ull));
+        }
+    };
+
+    std::unordered_map<std::pair<uint64_t, uint64_t>, Cached, KeyHash> entries;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+    bool changed = false;
+};
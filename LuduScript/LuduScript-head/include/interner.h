@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned string id 字符串编号
+using Symbol = uint32_t;
+
+// Symbols every StringTable interns up front, in this order, so they can be used as switch labels
+namespace sym
+{
+    enum : Symbol
+    {
+        // Object fields written by obj statements
+        CLASS, // "class"
+        ID,    // "id"
+        COUNT
+    };
+}
+
+// Per-program string table 字符串驻留表
+// Identifiers, string literals and class names are stored once and referred to by Symbol
+class StringTable
+{
+private:
+    std::deque<std::string> strings; // deque keeps the views in index stable
+    std::unordered_map<std::string_view, Symbol> index;
+
+public:
+    StringTable();
+
+    Symbol intern(std::string_view s);
+    bool find(std::string_view s, Symbol &id) const; // lookup without interning
+    const std::string &str(Symbol id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+};
@@ -1,72 +1,310 @@
 #pragma once
 
 #include "ast.h"
+#include "profiler.h"
+#include "sink.h"
+#include "small_vector.h"
 #include "nlohmann/json.hpp"
-#include <unordered_map>
-#include <unordered_set>
+#include <atomic>
+#include <cstring>
 #include <optional>
+#include <string_view>
 #include <vector>
 
 using json = nlohmann::json;
 
-// Loop control exceptions
-struct BreakException : std::exception
-{
-};
-struct ContinueException : std::exception
+// Control-flow signal returned by statement execution 控制流信号
+// break/continue travel back up to the enclosing for loop as a return value, not as an exception
+enum class Flow : uint8_t
 {
+    NORMAL,
+    BREAK,
+    CONTINUE
 };
 
 // Value type for runtime values
-struct Value
+// A 16-byte tagged union: bytes [0, 8) hold the int64 / double / bool payload or a pointer to a
+// shared string, strings of up to 14 bytes are stored inline in bytes [0, 14), byte 14 is the
+// inline length and byte 15 the tag. Copies never allocate; long strings are reference counted.
+class Value
 {
-    enum class Type
+public:
+    enum class Type : uint8_t
     {
         NUM,
         STR,
         BOOL
-    } type;
+    };
 
-    double nval;    // Numeric value (can represent both int and float)
-    bool isInteger; // Flag to indicate if the number should be treated as integer
-    std::string sval;
-    bool bval;
+    Value() { setScalar(TAG_FLOAT, 0.0); }
+    Value(const Value &o);
+    Value(Value &&o) noexcept;
+    Value &operator=(const Value &o);
+    Value &operator=(Value &&o) noexcept;
+    ~Value() { release(); }
 
     static Value makeInt(ll i);
     static Value makeNum(double n);
-    static Value makeStr(std::string s);
+    static Value makeStr(std::string_view s);
     static Value makeBool(bool b);
+    static Value makeDefault(const std::string &type); // Default value of a "num"/"str"/"bool" declaration
+    static Value concat(std::string_view a, std::string_view b);
+
+    Type type() const { return tag() == TAG_STR ? Type::STR : tag() == TAG_BOOL ? Type::BOOL : Type::NUM; }
+    bool isInt() const { return tag() == TAG_INT; } // Check if this numeric value should be treated as integer
+    bool isStr() const { return tag() == TAG_STR; }
+    bool isFloat() const { return tag() == TAG_FLOAT; }
+
+    // Raw payloads, only valid for the matching type
+    ll intVal() const { return load<ll>(); }
+    double numVal() const { return isInt() ? static_cast<double>(load<ll>()) : load<double>(); }
+    bool boolVal() const { return load<bool>(); }
+    std::string_view strVal() const;
 
     std::string toStr() const;
     double toNum() const;
     ll toInt() const;
     bool toBool() const;
-    bool isInt() const; // Check if this numeric value should be treated as integer
+    // Scalar JSON form, as the incremental cache stores values. What JSON cannot hold is written
+    // as a one-element array: non-finite doubles as their bit pattern, strings that are not
+    // UTF-8 as their bytes in hex
+    json toJson() const;
+    static Value fromJson(const json &j); // inverse of toJson; throws std::runtime_error on other JSON
+
+private:
+    enum Tag : uint8_t
+    {
+        TAG_INT,
+        TAG_FLOAT,
+        TAG_STR,
+        TAG_BOOL
+    };
+    static constexpr size_t kInlineCap = 14;
+    static constexpr uint8_t kHeapLen = 0xFF;
+
+    // Immutable, reference-counted string buffer; the characters follow the header
+    struct HeapStr
+    {
+        std::atomic<uint32_t> refs;
+        size_t size;
+        char *data() { return reinterpret_cast<char *>(this + 1); }
+    };
+
+    alignas(8) unsigned char bytes[16];
+
+    Tag tag() const { return static_cast<Tag>(bytes[15]); }
+    bool isHeapStr() const { return tag() == TAG_STR && bytes[14] == kHeapLen; }
+    HeapStr *heap() const { return load<HeapStr *>(); }
+
+    template <class T>
+    T load() const
+    {
+        T v;
+        std::memcpy(&v, bytes, sizeof(T));
+        return v;
+    }
+    template <class T>
+    void setScalar(Tag t, T v)
+    {
+        std::memcpy(bytes, &v, sizeof(T));
+        bytes[15] = t;
+    }
+
+    static Value allocStr(size_t size, char *&data); // String value with room for size chars
+    void retain() const;
+    void release();
+};
+static_assert(sizeof(Value) == 16, "Value must stay 16 bytes");
+
+// Operator semantics, shared by the tree walker and the bytecode VM
+namespace ops
+{
+    Value add(const Value &L, const Value &R);
+    Value sub(const Value &L, const Value &R);
+    Value mul(const Value &L, const Value &R);
+    Value div(const Value &L, const Value &R);
+    Value mod(const Value &L, const Value &R);
+    Value eq(const Value &L, const Value &R);
+    Value neq(const Value &L, const Value &R);
+    Value lt(const Value &L, const Value &R);
+    Value gt(const Value &L, const Value &R);
+    Value le(const Value &L, const Value &R);
+    Value ge(const Value &L, const Value &R);
+    Value logicalAnd(const Value &L, const Value &R);
+    Value logicalOr(const Value &L, const Value &R);
+    Value negate(const Value &r);
+    Value logicalNot(const Value &r);
+
+    // Jump table indexed by BinaryOp
+    using BinaryFn = Value (*)(const Value &, const Value &);
+    extern const BinaryFn binaryTable[static_cast<size_t>(BinaryOp::COUNT)];
+
+    // Dispatch with the int/int case inlined; comparisons keep the double semantics of lt/gt/le/ge
+    inline Value binary(BinaryOp op, const Value &L, const Value &R)
+    {
+        if (L.isInt() && R.isInt())
+        {
+            ll a = L.intVal(), b = R.intVal();
+            switch (op)
+            {
+            case BinaryOp::ADD:
+                return Value::makeInt(a + b);
+            case BinaryOp::SUB:
+                return Value::makeInt(a - b);
+            case BinaryOp::MUL:
+                return Value::makeInt(a * b);
+            case BinaryOp::EQ:
+                return Value::makeBool(a == b);
+            case BinaryOp::NEQ:
+                return Value::makeBool(a != b);
+            case BinaryOp::LT:
+                return Value::makeBool(static_cast<double>(a) < static_cast<double>(b));
+            case BinaryOp::GT:
+                return Value::makeBool(static_cast<double>(a) > static_cast<double>(b));
+            case BinaryOp::LE:
+                return Value::makeBool(static_cast<double>(a) <= static_cast<double>(b));
+            case BinaryOp::GE:
+                return Value::makeBool(static_cast<double>(a) >= static_cast<double>(b));
+            default:
+                break;
+            }
+        }
+        return binaryTable[static_cast<size_t>(op)](L, R);
+    }
+
+    inline Value unary(UnaryOp op, const Value &r)
+    {
+        return op == UnaryOp::NOT ? logicalNot(r) : negate(r);
+    }
+}
+
+// One field of a generated object
+struct ObjectField
+{
+    Symbol key;
+    bool declared; // readable by name inside the body; "class"/"id" start out undeclared
+    Value value;
+};
+
+// Read-only view of the fields of one object, wherever they are stored
+struct ObjectView
+{
+    const ObjectField *first = nullptr;
+    size_t count = 0;
+
+    const ObjectField *begin() const { return first; }
+    const ObjectField *end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const ObjectField &operator[](size_t i) const { return first[i]; }
+    const ObjectField *find(Symbol k) const;
+};
+
+// Object under construction 正在构建的对象
+// A flat list of (key, value) pairs in declaration order. Typical cards fit the inline storage,
+// so filling one in never allocates
+struct NativeObject
+{
+    using Field = ObjectField;
+    static constexpr size_t kInlineFields = 8;
+    SmallVector<Field, kInlineFields> fields; // "class" and "id" first, then in first-write order
+
+    Field *find(Symbol k);
+    const Field *find(Symbol k) const { return view().find(k); }
+    void set(Symbol k, const Value &v, bool declare);
+    ObjectView view() const { return {fields.begin(), fields.size()}; }
+};
+
+// Finished objects 输出对象列表
+// The fields of all objects back to back in one array, with the end of each object, so
+// emitting an object appends to shared storage instead of allocating one of its own
+class ObjectList
+{
+public:
+    size_t size() const { return ends.size(); }
+    bool empty() const { return ends.empty(); }
+    ObjectView operator[](size_t i) const
+    {
+        size_t first = i == 0 ? 0 : ends[i - 1];
+        return {fields.data() + first, ends[i] - first};
+    }
+
+    void push(ObjectView obj)
+    {
+        fields.insert(fields.end(), obj.begin(), obj.end());
+        ends.push_back(fields.size());
+    }
+    // Moves the objects of o to the end of this list
+    void append(ObjectList &&o);
+    void clear()
+    {
+        fields.clear();
+        ends.clear();
+    }
+
+private:
+    std::vector<ObjectField> fields;
+    std::vector<size_t> ends; // one past the last field of each object
 };
 
 // Runtime environment
 struct Env
 {
-    // Variable stack
-    std::vector<std::unordered_map<std::string, Value>> stack;
-    // Current object being built (if any)
-    std::optional<json> current_object;
-    // Set of declared object fields
-    std::unordered_set<std::string> declared_fields;
-    // Output array
-    json output = json::array();
-
-    void pushScope();
+    // Names and string literals of the running program
+    const StringTable *strings = nullptr;
+    // Scope frames, laid out back to back in one flat array
+    std::vector<Value> slots;
+    std::vector<char> slotSet; // whether slots[i] holds a value yet
+    std::vector<size_t> frames; // base index of each scope frame
+    // Objects being built, innermost last; a nested obj suspends the enclosing one.
+    // Entries past openObjects are kept so their field storage is reused by the next object
+    std::vector<NativeObject> objects;
+    size_t openObjects = 0;
+    // Finished objects, or the sink they are streamed to
+    ObjectList output;
+    ObjectSink *sink = nullptr;
+    FieldOrder fieldOrder = FieldOrder::SORTED; // of the serialised output
+
+    void pushScope(int size);
     void popScope();
-    void setVar(const std::string &k, const Value &v);
-    std::optional<Value> getVar(const std::string &k);
+    // First set variable among the resolved candidates, or nullptr
+    Value *findVar(const Slot *candidates, size_t count);
+    Value *findVar(const VarBinding &b) { return findVar(b.candidates.data(), b.candidates.size()); }
+    void setLocal(int slot, Value v); // slot of the innermost scope
+
+    // Object context
+    bool inObject() const { return openObjects > 0; }
+    NativeObject &currentObject() { return objects[openObjects - 1]; }
+    const NativeObject &currentObject() const { return objects[openObjects - 1]; }
+    void beginObject(Symbol className);
+    void setObjectId(const Value &id);
+    void endObject();   // Emit the current object and resume the enclosing one
+    // Append a finished object to the output or the sink
+    void emit(ObjectView obj);
+    void emit(ObjectList &&objects); // in order
+    // Set while the incremental cache records a statement; receives a copy of every emitted object
+    ObjectList *capture = nullptr;
+    void abortObject(); // Drop the current object without emitting it
+    void declareField(Symbol k, const Value &v);
+    void assignField(Symbol k, const Value &v);
+    // Identifier fallback inside an object: field value, or the name itself if not a declared field
+    std::optional<Value> lookupField(Symbol k) const;
+
+    // The output array as JSON; with sorted fields byte-identical to json::dump() / json::dump(2)
+    std::string serialize(bool pretty) const;
 };
 
+class ExecCache;
+
 // Interpreter class
 class Interpreter
 {
 private:
     Env env;
+    unsigned jobs = 1; // threads for independent top-level for loops
+    Profiler *profiler = nullptr; // only consulted in LUDUSCRIPT_PROFILER builds
+    ExecCache *cache = nullptr;
+    std::vector<int> globalSlotOf; // global slot of each interned name, -1 if none; cache runs only
 
     // Expression evaluation
     Value evalExpr(Expr *e);
@@ -77,17 +315,48 @@ private:
     Value evalCall(CallExpr *c);
     Value evalAccess(AccessExpr *a);
 
+    // Top-level statements, with or without the incremental cache
+    void execTopLevel(Stmt *s);
+    void execTopLevelCached(Stmt *s, const Program &program);
+    uint64_t hashGlobals(const std::vector<Symbol> &names, const StringTable &strings) const;
+
     // Statement execution
-    void execStmt(Stmt *s);
-    void execBlock(const std::vector<StmtPtr> &body);
+    // Statements that can contain break/continue return the signal so enclosing blocks stop early
+    Flow execStmt(Stmt *s);
+    Flow dispatchStmt(Stmt *s);
+    Flow execStmtProfiled(Stmt *s);
+    void execExprStmt(ExprStmt *es);
+    void execAssign(AssignStmt *as);
+    Flow execDecl(DeclStmt *ds);
+    Flow execIf(IfStmt *is);
+    void execFor(ForStmt *fs);
+    void evalForRange(ForStmt *fs, ll &start, ll &end, ll &step);
+    void execForRange(ForStmt *fs, ll start, ll end, ll step);
+    bool execForParallel(ForStmt *fs); // false if the loop must run sequentially
+    Flow execObj(ObjStmt *os);
+    Flow execBreak(BreakStmt *bs);
+    Flow execContinue(ContinueStmt *cs);
+    Flow execBody(const std::vector<StmtPtr> &body); // in the current scope
+    Flow execBlock(const std::vector<StmtPtr> &body, int slots);
 
     // Helper functions for return values
-    Value execIfWithReturn(IfStmt *is);
-    Value execBlockWithReturn(const std::vector<StmtPtr> &body);
+    Flow execIfWithReturn(IfStmt *is, Value &result);
+    Flow execBlockWithReturn(const std::vector<StmtPtr> &body, int slots, Value &result);
 
 public:
     Interpreter() = default;
 
-    void execute(Program *program);
+    void execute(const Program *program);
     std::string getOutput(bool pretty = false) const;
+    const ObjectList &getObjects() const { return env.output; } // unless a sink is set
+    // Stream objects to sink as they finish instead of collecting them for getOutput
+    void setSink(ObjectSink *sink) { env.sink = sink; }
+    // Field order of getOutput; a sink has its own
+    void setFieldOrder(FieldOrder order) { env.fieldOrder = order; }
+    // Run top-level for loops whose iterations only emit objects on up to n threads
+    void setJobs(unsigned n) { jobs = n; }
+    // Time every statement into p; false if this build has the profiler compiled out
+    bool setProfiler(Profiler *p);
+    // Replay top-level statements found in cache and record the others into it
+    void setCache(ExecCache *c) { cache = c; }
 };
\ No newline at end of file
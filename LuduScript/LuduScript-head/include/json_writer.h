@@ -0,0 +1,50 @@
+#pragma once
+
+#include "interpreter.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Direct JSON serialiser for generated objects 对象直接序列化
+// Writes generated objects straight from their Values, producing exactly the bytes json::dump() and
+// json::dump(2) would for the same objects: keys sorted, integers in decimal, doubles in the
+// shortest round-trip form, UTF-8 copied through and control characters escaped. With
+// FieldOrder::DECLARED the fields keep the object's own order and are otherwise formatted alike.
+// Objects of one class share their key set, so the key order and the escaped key prefixes
+// ("key": with the separator and indentation in front) are worked out once per key layout.
+class JsonWriter
+{
+public:
+    JsonWriter(const StringTable &strings, bool pretty, FieldOrder order = FieldOrder::SORTED);
+
+    // One object as an element of the output array; pretty objects are indented one level,
+    // as in dump(2) of the whole array
+    void writeObject(std::string &out, ObjectView obj);
+    // The whole output array, as getOutput returns it
+    void writeArray(std::string &out, const ObjectList &objects);
+
+    static void writeValue(std::string &out, const Value &v);
+    static void writeString(std::string &out, std::string_view s);
+    // Whether writeString accepts s; it throws on anything that is not well-formed UTF-8
+    static bool isUtf8(std::string_view s);
+
+private:
+    struct Layout
+    {
+        std::vector<Symbol> keys;          // in field order
+        std::vector<uint32_t> order;       // field indices in output order
+        std::vector<std::string> prefixes; // per output position: separator, indentation and "key":
+    };
+    static constexpr size_t kMaxLayouts = 64;
+
+    const StringTable &strings;
+    bool pretty;
+    FieldOrder fieldOrder;
+    std::vector<Layout> layouts;
+    size_t last = 0; // most recently used layout, usually the one of the next object too
+    Layout scratch;  // used once the cache is full
+
+    const Layout &layoutFor(ObjectView obj);
+    void buildLayout(Layout &layout, ObjectView obj) const;
+};
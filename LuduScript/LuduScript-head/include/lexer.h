@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class TokenKind
@@ -51,19 +53,25 @@ enum class TokenKind
     UNKNOWN
 };
 
+// Tokens point into the source buffer, which must outlive the lexer and its tokens.
+// A string literal's text is its raw body between the quotes; escaped is set when it
+// contains backslash escapes and has to go through Lexer::unescape.
 struct Token
 {
     TokenKind kind;
-    std::string text;
+    std::string_view text;
     int line;
+    bool escaped = false;
 
-    Token(TokenKind k = TokenKind::UNKNOWN, std::string t = "", int l = 1);
+    Token(TokenKind k = TokenKind::UNKNOWN, std::string_view t = {}, int l = 1, bool esc = false);
+
+    std::string str() const; // text with escapes resolved
 };
 
 class Lexer
 {
 private:
-    std::string src;
+    std::string_view src;
     size_t i = 0;
     int line = 1;
 
@@ -72,6 +80,51 @@ private:
     void skipWhitespace();
 
 public:
-    explicit Lexer(std::string s);
+    explicit Lexer(std::string_view s);
     Token nextToken();
-};
\ No newline at end of file
+
+    static std::string unescape(std::string_view raw);
+};
+
+// Tokenize-ahead ring buffer 预读词法单元缓冲区
+// The lexer fills a fixed ring of tokens in batches and the parser reads them in place by
+// offset from the current token, so neither consuming nor looking ahead copies anything.
+// Once END has been lexed it is returned for every position past the end of the input.
+class TokenBuffer
+{
+public:
+    static constexpr size_t kCapacity = 256; // power of two; also the lookahead limit
+
+    explicit TokenBuffer(std::string_view src) : lex(src) { fill(); }
+
+    // Token `ahead` positions after the current one; stays valid until `ahead` + 1 advances
+    const Token &peek(size_t ahead = 0)
+    {
+        if (ahead >= avail)
+        {
+            fill();
+            if (ahead >= avail)
+                ahead = avail - 1; // END
+        }
+        return ring[(head + ahead) & (kCapacity - 1)];
+    }
+
+    void advance()
+    {
+        if (avail == 1 && done)
+            return; // stay on END
+        head = (head + 1) & (kCapacity - 1);
+        if (--avail == 0)
+            fill();
+    }
+
+private:
+    Lexer lex;
+    std::array<Token, kCapacity> ring;
+    size_t head = 0;  // slot of the current token
+    size_t avail = 0; // lexed tokens from head on
+    bool done = false;
+
+    void fill();
+};
+
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sink.h"
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct Program;
+struct BytecodeProgram;
+
+// Embedding API of libluduscript 嵌入式接口
+// Compile a script once, keep the CompiledProgram (it is cheap to copy and immutable), and run it
+// as often as needed. Execute only reads the program, so any number of threads may run the same
+// CompiledProgram at once, each with its own sink.
+namespace luduscript
+{
+    enum class Engine
+    {
+        TREE, // tree-walking interpreter
+        VM    // bytecode VM, same output
+    };
+
+    struct ExecuteOptions
+    {
+        Engine engine = Engine::TREE;
+        unsigned jobs = 1;   // threads for independent top-level for loops (tree engine)
+        bool pretty = false; // only used when Execute returns the JSON as a string
+        FieldOrder fieldOrder = FieldOrder::SORTED; // likewise; a sink has its own
+    };
+
+    // Parsed, resolved and optimised script together with its bytecode
+    class CompiledProgram
+    {
+    public:
+        CompiledProgram() = default; // empty; Execute rejects it
+
+        explicit operator bool() const { return data != nullptr; }
+        const Program &ast() const;
+        const BytecodeProgram &bytecode() const;
+
+    private:
+        struct Data;
+        std::shared_ptr<const Data> data;
+
+        friend CompiledProgram Compile(std::string_view source, bool arena);
+    };
+
+    // Throws std::runtime_error with the parser's message on syntax errors. source is not
+    // referenced after Compile returns. arena allocates the AST nodes in one memory pool.
+    CompiledProgram Compile(std::string_view source, bool arena = false);
+
+    // Streams every object to sink and finishes it. Runtime errors are thrown as
+    // std::runtime_error and leave the sink unfinished.
+    void Execute(const CompiledProgram &program, ObjectSink &sink, const ExecuteOptions &opts = {});
+
+    // Runs the program and returns the JSON array, as printed by the command line tool
+    std::string Execute(const CompiledProgram &program, const ExecuteOptions &opts = {});
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+#include <optional>
+#include <vector>
+
+// AST optimisation pass 语法树优化
+// Runs after the Resolver and before execution or compilation. Every rewrite keeps the
+// observable behaviour, including the runtime errors of expressions that would fail.
+//   - BinaryExpr/UnaryExpr over literal operands are folded into a literal, as is && / || whose
+//     literal left operand decides the result
+//   - if/elif arms with a literal condition are resolved: false arms are dropped, a true arm ends the chain
+//   - a decl init block whose value is a single literal becomes a plain init expression
+class Optimizer
+{
+private:
+    Program *program = nullptr;
+
+    std::optional<Value> literalValue(const Expr *e) const;
+    ExprPtr makeLiteral(const Value &v, int line);
+
+    void foldExpr(ExprPtr &e);
+    void optimizeStmt(Stmt *s);
+    void optimizeBody(std::vector<StmtPtr> &body);
+    void pruneIf(IfStmt *is);
+    void simplifyDecl(DeclStmt *ds);
+    std::optional<Value> constantBlockValue(const std::vector<StmtPtr> &body) const;
+
+public:
+    Optimizer() = default;
+
+    void optimize(Program &program);
+};
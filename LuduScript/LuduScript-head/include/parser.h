@@ -9,15 +9,25 @@
 class Parser
 {
 private:
-    Lexer lex;
-    Token cur;
+    TokenBuffer tokens;
+    const Token *cur; // tokens.peek(), refreshed on every advance
+    std::shared_ptr<StringTable> strings; // handed to the Program once parsing is done
+    std::unique_ptr<Arena> arena;         // node storage in arena mode, handed over the same way
 
-    Token peek();
-    Token consume();
+    const Token &peek(size_t ahead = 0) { return tokens.peek(ahead); }
+    void consume()
+    {
+        tokens.advance();
+        cur = &tokens.peek();
+    }
     bool match(TokenKind k);
-    void expect(TokenKind k, const std::string &msg);
+    void expect(TokenKind k, const char *msg); // msg is only turned into a string on failure
     [[noreturn]] void error(const std::string &msg);
     bool isExpressionStart();
+    Symbol intern(std::string_view s) { return strings->intern(s); }
+    Symbol internLiteral(const Token &t) { return t.escaped ? intern(Lexer::unescape(t.text)) : intern(t.text); }
+    template <class T, class... Args>
+    NodePtr<T> node(Args &&...args) { return makeNode<T>(arena.get(), std::forward<Args>(args)...); }
 
     // Expression parsing
     ExprPtr parseExpr();
@@ -40,6 +50,8 @@ private:
     std::vector<StmtPtr> parseBlock();
 
 public:
-    explicit Parser(std::string src);
+    // src is not copied and must stay alive until parseProgram returns
+    // useArena: place every node in a monotonic arena owned by the Program instead of the heap
+    explicit Parser(std::string_view src, bool useArena = false);
     std::unique_ptr<Program> parseProgram();
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ast.h"
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Statement profiler 执行剖析
+// Records a calling-context tree of statements while a script runs: each context is one
+// statement reached through one chain of enclosing statements, with its hit count and inclusive
+// time. writeTable folds the tree into one row per source line and statement, with exclusive time
+// (inclusive minus nested statements); writeFlameGraph emits the tree as nested
+// {"name", "value", "children"} JSON, the input format of d3-flame-graph and similar viewers.
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Profiler();
+
+    void start(); // the whole run is the root context
+    void stop();
+
+    void enter(const Stmt *s)
+    {
+        uint32_t ctx = child(stack.back().first, s);
+        ++contexts[ctx].hits;
+        stack.emplace_back(ctx, Clock::now());
+    }
+
+    void exit()
+    {
+        auto [ctx, t0] = stack.back();
+        stack.pop_back();
+        contexts[ctx].total += Clock::now() - t0;
+    }
+
+    void writeTable(std::ostream &out, const StringTable &strings, size_t limit = 40) const;
+    void writeFlameGraph(std::ostream &out, const StringTable &strings) const;
+
+private:
+    struct Context
+    {
+        const Stmt *stmt; // null for the root
+        uint64_t hits = 0;
+        Clock::duration total{};
+        std::vector<uint32_t> children;
+
+        explicit Context(const Stmt *s) : stmt(s) {}
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const std::pair<uint32_t, const Stmt *> &k) const
+        {
+            return std::hash<const void *>()(k.second) ^ (static_cast<size_t>(k.first) * 0x9E3779B97F4A7C15ull);
+        }
+    };
+
+    std::vector<Context> contexts; // [0] is the root
+    std::unordered_map<std::pair<uint32_t, const Stmt *>, uint32_t, KeyHash> index;
+    std::vector<std::pair<uint32_t, Clock::time_point>> stack;
+
+    uint32_t child(uint32_t parent, const Stmt *s);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ast.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Compiled-program cache 编译结果缓存
+// Stores the resolved and optimised AST of a script in a binary file named after the hash of the
+// source, so a later run of the same script maps that file and rebuilds the nodes in one pass
+// instead of lexing, parsing, resolving and optimising again. Files record the source size, the
+// compiler version, a fingerprint of the frontend sources and a checksum of their contents; one
+// that does not match, or whose slot indexes do not fit the scopes they refer to, is a miss.
+class ProgramCache
+{
+public:
+    explicit ProgramCache(std::string dir) : dir(std::move(dir)) {}
+
+    // nullptr on a miss; loaded nodes always live in the program's arena
+    std::unique_ptr<Program> load(std::string_view source) const;
+    // Written through a temporary file and renamed, so concurrent runs never see partial files
+    bool store(std::string_view source, const Program &program) const;
+
+    std::string pathFor(std::string_view source) const;
+
+    static uint64_t hashSource(std::string_view source);
+
+private:
+    std::string dir;
+};
+
+// Binary form of a Program, as stored by ProgramCache (native byte order)
+void writeProgram(const Program &program, uint64_t sourceHash, uint64_t sourceSize, std::string &out);
+// Throws std::runtime_error if data is not a complete program for this source and compiler version
+std::unique_ptr<Program> readProgram(std::string_view data, uint64_t sourceHash, uint64_t sourceSize);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ast.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Static scope resolution 作用域解析
+// Gives every lexical scope a fixed frame layout and binds identifiers, assignments and
+// declarations to (depth, slot) pairs, so the runtime never hashes variable names.
+class Resolver
+{
+private:
+    using Scope = std::unordered_map<Symbol, int>;
+
+    std::vector<Scope> scopes;
+    int objectDepth = 0; // obj bodies enclosing the current statement
+
+    void collectSlots(const std::vector<StmtPtr> &body, Scope &scope);
+    int openScope(const std::vector<StmtPtr> &body, const Symbol *extra = nullptr);
+    void closeScope();
+    VarBinding bind(Symbol name) const;
+
+    void resolveExpr(Expr *e);
+    void resolveStmt(Stmt *s);
+    void resolveBody(const std::vector<StmtPtr> &body);
+    int resolveBlock(const std::vector<StmtPtr> &body);
+    void resolveDecl(DeclStmt *ds);
+
+public:
+    Resolver() = default;
+
+    void resolve(Program &program);
+};
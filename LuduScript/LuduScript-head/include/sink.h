@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+struct ObjectView;
+class StringTable;
+class JsonWriter;
+
+// Order of the fields within each serialised object 字段顺序
+enum class FieldOrder
+{
+    SORTED,  // by key, like nlohmann::json's std::map (the default, and the historical output)
+    DECLARED // as the script wrote them: "class", "id", then in first-write order
+};
+
+// Streaming object output 流式输出
+// Serialises each finished object straight to an ostream through a buffer, so the
+// generated objects never have to be held in memory together.
+class ObjectSink
+{
+public:
+    enum class Framing
+    {
+        ARRAY,  // one JSON array, byte-identical to the buffered output
+        NDJSON  // one compact object per line
+    };
+
+    ObjectSink(std::ostream &out, Framing framing, bool pretty = false, FieldOrder order = FieldOrder::SORTED);
+    ~ObjectSink();
+
+    void write(const ObjectView &obj, const StringTable &strings);
+    void finish(); // close the array framing and flush
+    size_t count() const { return objects; }
+
+private:
+    static constexpr size_t kFlushSize = 64 * 1024;
+
+    std::ostream &out;
+    Framing framing;
+    bool pretty;
+    FieldOrder order;
+    bool finished = false;
+    size_t objects = 0;
+    std::string buf;
+    std::unique_ptr<JsonWriter> writer; // for the StringTable of the objects written so far
+    const StringTable *writerStrings = nullptr;
+
+    void flush();
+};
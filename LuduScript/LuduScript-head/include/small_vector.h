@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Vector with inline room for N elements 小对象优化向量
+// The first N elements live inside the object itself, so a short list is built, copied and
+// destroyed without touching the heap; only lists that outgrow N move to an allocation.
+template <class T, size_t N>
+class SmallVector
+{
+public:
+    SmallVector() = default;
+    SmallVector(const SmallVector &o)
+    {
+        reserve(o.count);
+        for (const T &v : o)
+            push_back(v);
+    }
+    SmallVector(SmallVector &&o) noexcept { take(o); }
+    SmallVector &operator=(const SmallVector &o)
+    {
+        if (this != &o)
+        {
+            clear();
+            reserve(o.count);
+            for (const T &v : o)
+                push_back(v);
+        }
+        return *this;
+    }
+    SmallVector &operator=(SmallVector &&o) noexcept
+    {
+        if (this != &o)
+        {
+            clear();
+            release();
+            take(o);
+        }
+        return *this;
+    }
+    ~SmallVector()
+    {
+        clear();
+        release();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return cap; }
+    bool isInline() const { return ptr == inlineData(); }
+
+    T *begin() { return ptr; }
+    T *end() { return ptr + count; }
+    const T *begin() const { return ptr; }
+    const T *end() const { return ptr + count; }
+    T &operator[](size_t i) { return ptr[i]; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+    T &back() { return ptr[count - 1]; }
+
+    void push_back(const T &v) { emplace_back(v); }
+    void push_back(T &&v) { emplace_back(std::move(v)); }
+    template <class... Args>
+    T &emplace_back(Args &&...args)
+    {
+        if (count == cap)
+        {
+            // args may refer to an element of this vector, so build the new one first
+            T v(std::forward<Args>(args)...);
+            reserve(cap * 2);
+            return *new (ptr + count++) T(std::move(v));
+        }
+        return *new (ptr + count++) T(std::forward<Args>(args)...);
+    }
+
+    // Keeps the capacity, heap or inline, for the next fill
+    void clear()
+    {
+        for (size_t i = 0; i < count; ++i)
+            ptr[i].~T();
+        count = 0;
+    }
+
+    void reserve(size_t n)
+    {
+        if (n <= cap)
+            return;
+        T *p = static_cast<T *>(::operator new(n * sizeof(T)));
+        for (size_t i = 0; i < count; ++i)
+        {
+            new (p + i) T(std::move(ptr[i]));
+            ptr[i].~T();
+        }
+        release();
+        ptr = p;
+        cap = n;
+    }
+
+private:
+    alignas(T) unsigned char storage[N * sizeof(T)];
+    T *ptr = inlineData();
+    size_t count = 0;
+    size_t cap = N;
+
+    T *inlineData() { return reinterpret_cast<T *>(storage); }
+    const T *inlineData() const { return reinterpret_cast<const T *>(storage); }
+
+    // Frees a heap buffer (elements already destroyed) and returns to the inline storage
+    void release()
+    {
+        if (!isInline())
+            ::operator delete(ptr);
+        ptr = inlineData();
+        cap = N;
+    }
+
+    // Steals o's heap buffer, or moves its inline elements; o is left empty
+    void take(SmallVector &o)
+    {
+        if (o.isInline())
+        {
+            for (size_t i = 0; i < o.count; ++i)
+                new (ptr + i) T(std::move(o.ptr[i]));
+            count = o.count;
+            o.clear();
+        }
+        else
+        {
+            ptr = o.ptr;
+            count = o.count;
+            cap = o.cap;
+            o.ptr = o.inlineData();
+            o.count = 0;
+            o.cap = N;
+        }
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only script source 脚本源码缓冲区
+// Files are memory-mapped where the platform allows it, so the lexer reads the page cache
+// directly and tokens can point into the buffer without copying; other platforms, pipes and
+// empty files fall back to a string read in one go.
+class SourceBuffer
+{
+private:
+    const char *data = "";
+    size_t size = 0;
+    void *mapping = nullptr; // mmap'ed region, or null when the text lives in owned
+    std::string owned;
+
+    void release();
+
+public:
+    SourceBuffer() = default;
+    explicit SourceBuffer(std::string text);
+    SourceBuffer(SourceBuffer &&other) noexcept;
+    SourceBuffer &operator=(SourceBuffer &&other) noexcept;
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+
+    // Returns false when the file cannot be opened
+    bool load(const std::string &path);
+
+    std::string_view view() const { return {data, size}; }
+    bool mapped() const { return mapping != nullptr; }
+};
+
+// Replaces path with bytes through a temporary file named after the process and thread and a
+// rename, so readers and concurrent writers only ever see a complete old or new file
+bool replaceFile(const std::string &path, std::string_view bytes);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bytecode.h"
+#include "interpreter.h"
+#include <vector>
+
+// Stack VM executing a BytecodeProgram 字节码虚拟机
+class VM
+{
+private:
+    struct LoopState
+    {
+        ll cur;
+        ll end;
+        ll step;
+    };
+
+    Env env; // scope frames, object context and output, shared with the tree walker
+    std::vector<Value> stack;
+    std::vector<LoopState> loops;
+
+    Value *findVar(const BytecodeProgram &p, const VarRef &ref);
+
+    void run(const BytecodeProgram &p, size_t &pc);
+
+public:
+    VM() = default;
+
+    void execute(const BytecodeProgram &program);
+    std::string getOutput(bool pretty = false) const;
+    const ObjectList &getObjects() const { return env.output; } // unless a sink is set
+    void setSink(ObjectSink *sink) { env.sink = sink; }
+    void setFieldOrder(FieldOrder order) { env.fieldOrder = order; }
+};
@@ -0,0 +1,16 @@
+#include "arena.h"
+
+void *Arena::grow(size_t size, size_t align)
+{
+    // Blocks double up to 1 MiB; an oversized request gets a block of its own
+    size_t blockSize = nextBlockSize;
+    if (blockSize < size + align)
+        blockSize = size + align;
+    if (nextBlockSize < 1024 * 1024)
+        nextBlockSize *= 2;
+
+    blocks.emplace_back(new char[blockSize]);
+    cur = blocks.back().get();
+    left = blockSize;
+    return allocate(size, align);
+}
@@ -1,48 +1,239 @@
 #include "ast.h"
+#include <iomanip>
+#include <ostream>
+#include <sstream>
 
 // LiteralExpr constructors
-LiteralExpr::LiteralExpr(ll v, int l) : Expr(l), kind(Kind::INTEGER), ival(v) {}
-LiteralExpr::LiteralExpr(double d, int l) : Expr(l), kind(Kind::FLOAT), dval(d) {}
-LiteralExpr::LiteralExpr(std::string s, int l) : Expr(l), kind(Kind::STRING), sval(std::move(s)) {}
-LiteralExpr::LiteralExpr(bool b, int l) : Expr(l), kind(Kind::BOOL), bval(b) {}
+LiteralExpr::LiteralExpr(ll v, int l) : Expr(NodeKind::LITERAL, l), litKind(Kind::INTEGER), ival(v) {}
+LiteralExpr::LiteralExpr(double d, int l) : Expr(NodeKind::LITERAL, l), litKind(Kind::FLOAT), dval(d) {}
+LiteralExpr::LiteralExpr(Symbol s, int l) : Expr(NodeKind::LITERAL, l), litKind(Kind::STRING), sval(s) {}
+LiteralExpr::LiteralExpr(bool b, int l) : Expr(NodeKind::LITERAL, l), litKind(Kind::BOOL), bval(b) {}
 
 // IdentExpr constructor
-IdentExpr::IdentExpr(std::string n, int l) : Expr(l), name(std::move(n)) {}
+IdentExpr::IdentExpr(Symbol n, int l) : Expr(NodeKind::IDENT, l), name(n) {}
+
+// Operator spellings, indexed by the enums
+const char *opText(UnaryOp op)
+{
+    return op == UnaryOp::NOT ? "!" : "-";
+}
+
+const char *opText(BinaryOp op)
+{
+    static const char *const text[] = {"+", "-", "*", "/", "%", "==", "!=", "<", ">", "<=", ">=", "&&", "||"};
+    return text[static_cast<size_t>(op)];
+}
 
 // UnaryExpr constructor
-UnaryExpr::UnaryExpr(std::string o, ExprPtr r, int l) : Expr(l), op(std::move(o)), rhs(std::move(r)) {}
+UnaryExpr::UnaryExpr(UnaryOp o, ExprPtr r, int l) : Expr(NodeKind::UNARY, l), op(o), rhs(std::move(r)) {}
 
 // BinaryExpr constructor
-BinaryExpr::BinaryExpr(ExprPtr l, std::string o, ExprPtr r, int ln) : Expr(ln), op(std::move(o)), lhs(std::move(l)), rhs(std::move(r)) {}
+BinaryExpr::BinaryExpr(ExprPtr l, BinaryOp o, ExprPtr r, int ln) : Expr(NodeKind::BINARY, ln), op(o), lhs(std::move(l)), rhs(std::move(r)) {}
 
 // CallExpr constructor
-CallExpr::CallExpr(ExprPtr c, std::vector<ExprPtr> a, int l) : Expr(l), callee(std::move(c)), args(std::move(a)) {}
+CallExpr::CallExpr(ExprPtr c, std::vector<ExprPtr> a, int l) : Expr(NodeKind::CALL, l), callee(std::move(c)), args(std::move(a)) {}
 
 // AccessExpr constructor
-AccessExpr::AccessExpr(ExprPtr t, std::string m, int l) : Expr(l), target(std::move(t)), member(std::move(m)) {}
+AccessExpr::AccessExpr(ExprPtr t, Symbol m, int l) : Expr(NodeKind::ACCESS, l), target(std::move(t)), member(m) {}
 
 // Program constructor
-Program::Program() : Node(1) {}
+Program::Program() : Node(NodeKind::PROGRAM, 1) {}
 
 // ExprStmt constructor
-ExprStmt::ExprStmt(ExprPtr e, int l) : Stmt(l), expr(std::move(e)) {}
+ExprStmt::ExprStmt(ExprPtr e, int l) : Stmt(NodeKind::EXPR_STMT, l), expr(std::move(e)) {}
 
 // AssignStmt constructor
-AssignStmt::AssignStmt(std::string n, ExprPtr e, int l) : Stmt(l), name(std::move(n)), expr(std::move(e)) {}
+AssignStmt::AssignStmt(Symbol n, ExprPtr e, int l) : Stmt(NodeKind::ASSIGN, l), name(n), expr(std::move(e)) {}
 
 // DeclStmt constructors
-DeclStmt::DeclStmt(std::string t, std::string n, std::optional<ExprPtr> i, int l) : Stmt(l), type(std::move(t)), name(std::move(n)), init(std::move(i)) {}
-DeclStmt::DeclStmt(std::string t, std::string n, std::vector<StmtPtr> block, int l) : Stmt(l), type(std::move(t)), name(std::move(n)), initBlock(std::move(block)) {}
+DeclStmt::DeclStmt(std::string t, Symbol n, std::optional<ExprPtr> i, int l) : Stmt(NodeKind::DECL, l), type(std::move(t)), name(n), init(std::move(i)) {}
+DeclStmt::DeclStmt(std::string t, Symbol n, std::vector<StmtPtr> block, int l) : Stmt(NodeKind::DECL, l), type(std::move(t)), name(n), initBlock(std::move(block)) {}
 
 // IfStmt constructor
-IfStmt::IfStmt(ExprPtr c, int l) : Stmt(l), cond(std::move(c)) {}
+IfStmt::IfStmt(ExprPtr c, int l) : Stmt(NodeKind::IF, l), cond(std::move(c)) {}
 
 // ForStmt constructor
-ForStmt::ForStmt(std::string it, int l) : Stmt(l), iter(std::move(it)) {}
+ForStmt::ForStmt(Symbol it, int l) : Stmt(NodeKind::FOR, l), iter(it) {}
 
 // ObjStmt constructor
-ObjStmt::ObjStmt(std::string c, ExprPtr id, int l) : Stmt(l), className(std::move(c)), idExpr(std::move(id)) {}
+ObjStmt::ObjStmt(Symbol c, ExprPtr id, int l) : Stmt(NodeKind::OBJ, l), className(c), idExpr(std::move(id)) {}
+
+BreakStmt::BreakStmt(std::vector<StmtPtr> b, int l) : Stmt(NodeKind::BREAK, l), body(std::move(b)) {}
+
+ContinueStmt::ContinueStmt(std::vector<StmtPtr> b, int l) : Stmt(NodeKind::CONTINUE, l), body(std::move(b)) {}
+
+// AST listing
+namespace
+{
+    struct AstDumper
+    {
+        const StringTable &strings;
+        std::ostream &out;
+
+        void line(int depth, const Node *n, const std::string &text)
+        {
+            out << std::string(depth * 2, ' ') << text;
+            if (n)
+                out << "  @" << n->line;
+            out << '\n';
+        }
+
+        std::string quote(const std::string &s)
+        {
+            std::string q = "\"";
+            for (char c : s)
+            {
+                if (c == '"' || c == '\\')
+                    q += '\\';
+                if (c == '\n')
+                    q += "\\n";
+                else
+                    q += c;
+            }
+            return q + '"';
+        }
+
+        void expr(const Expr *e, int depth)
+        {
+            switch (e->kind)
+            {
+            case NodeKind::LITERAL:
+            {
+                auto lit = static_cast<const LiteralExpr *>(e);
+                std::ostringstream text;
+                text << "Literal ";
+                if (lit->litKind == LiteralExpr::Kind::INTEGER)
+                    text << "int " << lit->ival;
+                else if (lit->litKind == LiteralExpr::Kind::FLOAT)
+                    text << "float " << std::setprecision(15) << lit->dval;
+                else if (lit->litKind == LiteralExpr::Kind::STRING)
+                    text << "str " << quote(strings.str(lit->sval));
+                else
+                    text << "bool " << (lit->bval ? "true" : "false");
+                line(depth, e, text.str());
+                return;
+            }
+            case NodeKind::IDENT:
+                line(depth, e, "Ident " + strings.str(static_cast<const IdentExpr *>(e)->name));
+                return;
+            case NodeKind::UNARY:
+            {
+                auto u = static_cast<const UnaryExpr *>(e);
+                line(depth, e, std::string("Unary ") + opText(u->op));
+                expr(u->rhs.get(), depth + 1);
+                return;
+            }
+            case NodeKind::BINARY:
+            {
+                auto b = static_cast<const BinaryExpr *>(e);
+                line(depth, e, std::string("Binary ") + opText(b->op));
+                expr(b->lhs.get(), depth + 1);
+                expr(b->rhs.get(), depth + 1);
+                return;
+            }
+            case NodeKind::CALL:
+            {
+                auto c = static_cast<const CallExpr *>(e);
+                line(depth, e, "Call");
+                expr(c->callee.get(), depth + 1);
+                for (auto &arg : c->args)
+                    expr(arg.get(), depth + 1);
+                return;
+            }
+            case NodeKind::ACCESS:
+            {
+                auto a = static_cast<const AccessExpr *>(e);
+                line(depth, e, "Access ." + strings.str(a->member));
+                expr(a->target.get(), depth + 1);
+                return;
+            }
+            default:
+                return;
+            }
+        }
+
+        void body(const char *label, const std::vector<StmtPtr> &stmts, int depth)
+        {
+            line(depth, nullptr, label);
+            for (auto &st : stmts)
+                stmt(st.get(), depth + 1);
+        }
 
-BreakStmt::BreakStmt(std::vector<StmtPtr> b, int l) : Stmt(l), body(std::move(b)) {}
+        void stmt(const Stmt *s, int depth)
+        {
+            switch (s->kind)
+            {
+            case NodeKind::EXPR_STMT:
+                line(depth, s, "ExprStmt");
+                expr(static_cast<const ExprStmt *>(s)->expr.get(), depth + 1);
+                return;
+            case NodeKind::ASSIGN:
+            {
+                auto as = static_cast<const AssignStmt *>(s);
+                line(depth, s, "Assign " + strings.str(as->name));
+                expr(as->expr.get(), depth + 1);
+                return;
+            }
+            case NodeKind::DECL:
+            {
+                auto ds = static_cast<const DeclStmt *>(s);
+                line(depth, s, "Decl " + ds->type + " " + strings.str(ds->name));
+                if (ds->init.has_value())
+                    expr(ds->init->get(), depth + 1);
+                else if (!ds->initBlock.empty())
+                    body("block:", ds->initBlock, depth + 1);
+                return;
+            }
+            case NodeKind::IF:
+            {
+                auto is = static_cast<const IfStmt *>(s);
+                line(depth, s, "If");
+                expr(is->cond.get(), depth + 1);
+                body("then:", is->thenBody, depth + 1);
+                for (auto &elif : is->elifs)
+                {
+                    line(depth + 1, elif.first.get(), "elif:");
+                    expr(elif.first.get(), depth + 2);
+                    body("then:", elif.second, depth + 2);
+                }
+                if (!is->elseBody.empty())
+                    body("else:", is->elseBody, depth + 1);
+                return;
+            }
+            case NodeKind::FOR:
+            {
+                auto fs = static_cast<const ForStmt *>(s);
+                line(depth, s, "For " + strings.str(fs->iter));
+                for (auto &arg : fs->args)
+                    expr(arg.get(), depth + 1);
+                body("body:", fs->body, depth + 1);
+                return;
+            }
+            case NodeKind::OBJ:
+            {
+                auto os = static_cast<const ObjStmt *>(s);
+                line(depth, s, "Obj " + quote(strings.str(os->className)));
+                expr(os->idExpr.get(), depth + 1);
+                body("body:", os->body, depth + 1);
+                return;
+            }
+            case NodeKind::BREAK:
+                body("Break", static_cast<const BreakStmt *>(s)->body, depth);
+                return;
+            case NodeKind::CONTINUE:
+                body("Continue", static_cast<const ContinueStmt *>(s)->body, depth);
+                return;
+            default:
+                return;
+            }
+        }
+    };
+}
 
-ContinueStmt::ContinueStmt(std::vector<StmtPtr> b, int l) : Stmt(l), body(std::move(b)) {}
\ No newline at end of file
+void dumpAst(const Program &program, std::ostream &out)
+{
+    AstDumper d{*program.strings, out};
+    out << "Program\n";
+    for (auto &st : program.stmts)
+        d.stmt(st.get(), 1);
+}
@@ -0,0 +1,188 @@
+#include "batch.h"
+#include "source.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct ScriptResult
+    {
+        fs::path script;
+        fs::path output;
+        int status = 0;
+        std::string error;
+        double ms = 0;
+    };
+
+    // Directory entries or manifest lines, in order
+    bool collectScripts(const std::string &input, std::vector<fs::path> &scripts, std::ostream &err)
+    {
+        std::error_code ec;
+        if (fs::is_directory(input, ec))
+        {
+            for (auto &entry : fs::directory_iterator(input, ec))
+            {
+                if (entry.is_regular_file() && entry.path().extension() == ".gen")
+                    scripts.push_back(entry.path());
+            }
+            std::sort(scripts.begin(), scripts.end());
+            return !ec;
+        }
+
+        std::ifstream manifest(input);
+        if (!manifest)
+        {
+            err << "Cannot open " << input << std::endl;
+            return false;
+        }
+        fs::path base = fs::path(input).parent_path();
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#')
+                continue;
+            size_t e = line.find_last_not_of(" \t\r");
+            fs::path p = line.substr(b, e - b + 1);
+            scripts.push_back(p.is_absolute() ? p : base / p);
+        }
+        return true;
+    }
+
+    void runOne(ScriptResult &r, const RunOptions &opts)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        SourceBuffer source;
+        if (!source.load(r.script.string()))
+        {
+            r.status = 2;
+            r.error = "Cannot open " + r.script.string();
+        }
+        else
+        {
+            RunOptions scriptOpts = opts;
+            scriptOpts.outputFile = r.output.string();
+            std::ostringstream out, err;
+            r.status = runScript(source.view(), scriptOpts, out, err);
+            r.error = err.str();
+            while (!r.error.empty() && r.error.back() == '\n')
+                r.error.pop_back();
+        }
+        r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+}
+
+int runBatch(const BatchOptions &batch, const RunOptions &opts, std::ostream &out, std::ostream &err)
+{
+    std::vector<fs::path> scripts;
+    if (!collectScripts(batch.input, scripts, err))
+        return 2;
+    if (scripts.empty())
+    {
+        err << "No scripts found in " << batch.input << std::endl;
+        return 2;
+    }
+
+    std::error_code ec;
+    fs::create_directories(batch.outDir, ec);
+    if (ec)
+    {
+        err << "Cannot create " << batch.outDir << ": " << ec.message() << std::endl;
+        return 3;
+    }
+
+    // Two scripts with the same name would overwrite each other's output
+    std::vector<ScriptResult> results(scripts.size());
+    std::set<fs::path> outputs;
+    for (size_t i = 0; i < scripts.size(); ++i)
+    {
+        results[i].script = scripts[i];
+        results[i].output = fs::path(batch.outDir) / scripts[i].stem();
+        results[i].output += opts.format == "columnar" ? ".ldcol" : ".json";
+        if (!outputs.insert(results[i].output).second)
+        {
+            results[i].status = 3;
+            results[i].error = "Duplicate output " + results[i].output.string();
+        }
+    }
+
+    // Scripts are the unit of parallelism, so each one runs its loops single-threaded
+    RunOptions scriptOpts = opts;
+    scriptOpts.jobs = 1;
+    unsigned threads = static_cast<unsigned>(std::min<size_t>(std::max(1u, batch.threads), scripts.size()));
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    auto work = [&]()
+    {
+        for (size_t i; (i = next++) < results.size();)
+        {
+            if (results[i].status == 0)
+                runOne(results[i], scriptOpts);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(work);
+    work();
+    for (auto &t : pool)
+        t.join();
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    // Summary 汇总
+    size_t failed = 0;
+    double cpuMs = 0;
+    nlohmann::json summary;
+    summary["scripts"] = nlohmann::json::array();
+    out << std::fixed << std::setprecision(1);
+    for (auto &r : results)
+    {
+        bool ok = r.status == 0;
+        failed += ok ? 0 : 1;
+        cpuMs += r.ms;
+        out << (ok ? "  ok   " : "  FAIL ") << std::setw(9) << r.ms << " ms  " << r.script.string();
+        if (ok)
+            out << " -> " << r.output.string() << "\n";
+        else
+            out << "\n         " << r.error << "\n";
+
+        nlohmann::json entry;
+        entry["script"] = r.script.string();
+        entry["output"] = r.output.string();
+        entry["ok"] = ok;
+        entry["ms"] = r.ms;
+        if (!ok)
+            entry["error"] = r.error;
+        summary["scripts"].push_back(std::move(entry));
+    }
+    out << "Batch: " << results.size() << " scripts, " << results.size() - failed << " ok, " << failed << " failed; "
+        << wallMs << " ms wall, " << cpuMs << " ms total on " << threads << " thread(s)" << std::endl;
+
+    if (!batch.summaryFile.empty())
+    {
+        summary["total"] = results.size();
+        summary["failed"] = failed;
+        summary["wallMs"] = wallMs;
+        summary["threads"] = threads;
+        std::ofstream ofs(batch.summaryFile);
+        if (!ofs)
+        {
+            err << "Cannot write to " << batch.summaryFile << std::endl;
+            return 3;
+        }
+        ofs << summary.dump(2) << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+#include "columnar.h"
+#include "columnar_reader.h"
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace col = luduscript::columnar;
+
+namespace
+{
+    col::ColumnType typeOf(const Value &v)
+    {
+        if (v.isInt())
+            return col::ColumnType::I64;
+        if (v.isFloat())
+            return col::ColumnType::F64;
+        return v.isStr() ? col::ColumnType::STR : col::ColumnType::BOOL;
+    }
+
+    struct Cell
+    {
+        const Value *value = nullptr; // null where the object lacks the field
+        uint32_t str = 0;             // dictionary id of a string value
+    };
+
+    // One field of a class while the file is laid out
+    struct Column
+    {
+        Symbol key;
+        unsigned types = 0; // bit per ColumnType seen
+        std::vector<Cell> cells;
+        col::ColumnType type = col::ColumnType::I64;
+        bool missing = false;
+    };
+
+    struct Group
+    {
+        uint32_t name = 0;
+        size_t rows = 0;
+        std::vector<Column> columns;
+        std::vector<int> columnOf; // by key Symbol, -1 if the class has no such field yet
+    };
+
+    // String dictionary, ids in order of first use
+    struct Dictionary
+    {
+        std::unordered_map<std::string_view, uint32_t> ids;
+        std::vector<std::string_view> list;
+
+        uint32_t id(std::string_view s)
+        {
+            auto [it, added] = ids.emplace(s, static_cast<uint32_t>(list.size()));
+            if (added)
+                list.push_back(s);
+            return it->second;
+        }
+    };
+
+    // Output image; sections are appended and their offsets patched into the tables afterwards
+    struct Image
+    {
+        std::string bytes;
+
+        size_t align()
+        {
+            bytes.resize((bytes.size() + 7) & ~size_t(7), '\0');
+            return bytes.size();
+        }
+        size_t reserve(size_t n)
+        {
+            size_t at = align();
+            bytes.resize(at + n, '\0');
+            return at;
+        }
+        template <class T>
+        void put(size_t at, const T &v)
+        {
+            std::memcpy(&bytes[at], &v, sizeof(T));
+        }
+    };
+
+    // 8-byte payload of one cell of an ANY column
+    uint64_t payload(const Cell &c)
+    {
+        const Value &v = *c.value;
+        switch (typeOf(v))
+        {
+        case col::ColumnType::I64:
+            return static_cast<uint64_t>(v.intVal());
+        case col::ColumnType::BOOL:
+            return v.boolVal() ? 1 : 0;
+        case col::ColumnType::STR:
+            return c.str;
+        default:
+            break;
+        }
+        double d = v.numVal();
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(d));
+        return bits;
+    }
+
+    // Lays out the arrays of one column and fills in everything but its name
+    void writeColumn(Image &img, const Column &c, size_t rows, col::ColumnEntry &entry)
+    {
+        entry.type = c.type;
+        entry.presentOffset = 0;
+        entry.tagsOffset = 0;
+
+        switch (c.type)
+        {
+        case col::ColumnType::I64:
+        case col::ColumnType::F64:
+            entry.dataOffset = img.reserve(rows * 8);
+            for (size_t r = 0; r < rows; ++r)
+            {
+                const Value *v = c.cells[r].value;
+                if (!v)
+                    continue;
+                if (c.type == col::ColumnType::I64)
+                    img.put(entry.dataOffset + r * 8, v->intVal());
+                else
+                    img.put(entry.dataOffset + r * 8, v->numVal()); // integers widen in a float column
+            }
+            break;
+        case col::ColumnType::BOOL:
+            entry.dataOffset = img.reserve(rows);
+            for (size_t r = 0; r < rows; ++r)
+                if (c.cells[r].value)
+                    img.bytes[entry.dataOffset + r] = c.cells[r].value->boolVal() ? 1 : 0;
+            break;
+        case col::ColumnType::STR:
+            entry.dataOffset = img.reserve(rows * 4);
+            for (size_t r = 0; r < rows; ++r)
+                if (c.cells[r].value)
+                    img.put(entry.dataOffset + r * 4, c.cells[r].str);
+            break;
+        case col::ColumnType::ANY:
+            entry.tagsOffset = img.reserve(rows);
+            entry.dataOffset = img.reserve(rows * 8);
+            for (size_t r = 0; r < rows; ++r)
+            {
+                if (!c.cells[r].value)
+                    continue;
+                img.bytes[entry.tagsOffset + r] = static_cast<char>(typeOf(*c.cells[r].value));
+                img.put(entry.dataOffset + r * 8, payload(c.cells[r]));
+            }
+            break;
+        }
+
+        if (c.missing)
+        {
+            entry.presentOffset = img.reserve((rows + 7) / 8);
+            for (size_t r = 0; r < rows; ++r)
+                if (c.cells[r].value)
+                    img.bytes[entry.presentOffset + r / 8] |= static_cast<char>(1 << (r % 8));
+        }
+    }
+}
+
+std::string encodeColumnar(const ObjectList &objects, const StringTable &strings)
+{
+    Dictionary dict;
+    dict.ids.reserve(objects.size() * 2);
+    std::deque<std::string> classNames; // "class" values that are not strings, printed
+    std::vector<Group> groups;
+    std::unordered_map<uint32_t, size_t> groupOf; // class name id -> groups
+
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        ObjectView obj = objects[i];
+        const ObjectField *cls = obj.find(sym::CLASS);
+        std::string_view className;
+        if (cls && cls->value.isStr())
+            className = cls->value.strVal();
+        else if (cls)
+            className = classNames.emplace_back(cls->value.toStr());
+        uint32_t name = dict.id(className);
+
+        auto [it, added] = groupOf.emplace(name, groups.size());
+        if (added)
+        {
+            Group &g = groups.emplace_back();
+            g.name = name;
+            g.columnOf.assign(strings.size(), -1);
+        }
+        Group &g = groups[it->second];
+        size_t row = g.rows++;
+
+        for (auto &f : obj)
+        {
+            if (f.key == sym::CLASS)
+                continue;
+            int &ci = g.columnOf[f.key];
+            if (ci < 0)
+            {
+                ci = static_cast<int>(g.columns.size());
+                g.columns.emplace_back().key = f.key;
+                dict.id(strings.str(f.key));
+            }
+            Column &c = g.columns[ci];
+            c.cells.resize(row + 1);
+            c.cells[row].value = &f.value;
+            c.types |= 1u << static_cast<unsigned>(typeOf(f.value));
+            if (f.value.isStr())
+                c.cells[row].str = dict.id(f.value.strVal());
+        }
+    }
+
+    for (auto &g : groups)
+    {
+        for (auto &c : g.columns)
+        {
+            c.cells.resize(g.rows);
+            for (auto &cell : c.cells)
+                c.missing = c.missing || !cell.value;
+
+            constexpr unsigned numeric = (1u << static_cast<unsigned>(col::ColumnType::I64)) |
+                                         (1u << static_cast<unsigned>(col::ColumnType::F64));
+            if (c.types == numeric)
+                c.type = col::ColumnType::F64;
+            else
+            {
+                // A single type bit names the column type, anything else mixes types
+                c.type = col::ColumnType::ANY;
+                for (unsigned t = 0; t < static_cast<unsigned>(col::ColumnType::ANY); ++t)
+                    if (c.types == 1u << t)
+                        c.type = static_cast<col::ColumnType>(t);
+            }
+        }
+    }
+
+    // Every string is in the dictionary by now, so it can be written first
+    Image img;
+    img.reserve(sizeof(col::FileHeader));
+    col::FileHeader header{};
+    std::memcpy(header.magic, col::kMagic, 4);
+    header.version = col::kVersion;
+    header.byteOrder = col::kByteOrder;
+    header.classCount = static_cast<uint32_t>(groups.size());
+    header.stringCount = dict.list.size();
+
+    header.stringsOffset = img.reserve((dict.list.size() + 1) * 8);
+    uint64_t pos = 0;
+    for (size_t i = 0; i < dict.list.size(); ++i)
+    {
+        img.put(header.stringsOffset + i * 8, pos);
+        img.bytes.append(dict.list[i].data(), dict.list[i].size());
+        pos += dict.list[i].size();
+    }
+    img.put(header.stringsOffset + dict.list.size() * 8, pos);
+
+    header.classesOffset = img.reserve(groups.size() * sizeof(col::ClassEntry));
+    for (size_t gi = 0; gi < groups.size(); ++gi)
+    {
+        Group &g = groups[gi];
+        col::ClassEntry ce{};
+        ce.name = g.name;
+        ce.columnCount = static_cast<uint32_t>(g.columns.size());
+        ce.rows = g.rows;
+        ce.columnsOffset = img.reserve(g.columns.size() * sizeof(col::ColumnEntry));
+        for (size_t k = 0; k < g.columns.size(); ++k)
+        {
+            col::ColumnEntry entry{};
+            writeColumn(img, g.columns[k], g.rows, entry);
+            entry.name = dict.id(strings.str(g.columns[k].key));
+            img.put(ce.columnsOffset + k * sizeof(col::ColumnEntry), entry);
+        }
+        img.put(header.classesOffset + gi * sizeof(col::ClassEntry), ce);
+    }
+    img.align();
+    img.put(0, header);
+
+    return std::move(img.bytes);
+}
@@ -0,0 +1,393 @@
+#include "bytecode.h"
+#include <stdexcept>
+
+size_t Compiler::emit(OpCode op, int a, int b, int line)
+{
+    out.code.push_back(Instr{op, a, b, line});
+    return out.code.size() - 1;
+}
+
+int Compiler::here() const
+{
+    return static_cast<int>(out.code.size());
+}
+
+int Compiler::addConst(Value v)
+{
+    out.consts.push_back(std::move(v));
+    return static_cast<int>(out.consts.size() - 1);
+}
+
+int Compiler::addMessage(const std::string &msg)
+{
+    auto it = messageIds.find(msg);
+    if (it != messageIds.end())
+        return it->second;
+    out.messages.push_back(msg);
+    int id = static_cast<int>(out.messages.size() - 1);
+    messageIds.emplace(msg, id);
+    return id;
+}
+
+int Compiler::addRef(Symbol name, const VarBinding &binding, int ownSlot)
+{
+    VarRef ref;
+    ref.name = name;
+    ref.ownSlot = ownSlot;
+    ref.first = static_cast<uint32_t>(out.candidates.size());
+    ref.count = static_cast<uint32_t>(binding.candidates.size());
+    out.candidates.insert(out.candidates.end(), binding.candidates.begin(), binding.candidates.end());
+    out.refs.push_back(ref);
+    return static_cast<int>(out.refs.size() - 1);
+}
+
+void Compiler::openScope(int slots, int line)
+{
+    emit(OpCode::PUSH_SCOPE, slots, 0, line);
+    ++scopeDepth;
+}
+
+void Compiler::closeScope(int line)
+{
+    emit(OpCode::POP_SCOPE, 0, 0, line);
+    --scopeDepth;
+}
+
+// Drop everything break/continue leaves behind inside the loop body
+void Compiler::emitUnwind(const Loop &loop, int line)
+{
+    for (int i = pending; i > loop.pending; --i)
+        emit(OpCode::POP, 0, 0, line);
+    for (int i = objectDepth; i > loop.objects; --i)
+        emit(OpCode::OBJ_ABORT, 0, 0, line);
+    for (int i = scopeDepth; i > loop.scopeDepth; --i)
+        emit(OpCode::POP_SCOPE, 0, 0, line);
+}
+
+BytecodeProgram Compiler::compile(const Program &program)
+{
+    out = BytecodeProgram();
+    loops.clear();
+    messageIds.clear();
+    scopeDepth = 1; // the global scope always exists
+    objectDepth = 0;
+    pending = 0;
+
+    out.globalSlots = program.globalSlots;
+    out.strings = program.strings;
+
+    compileBody(program.stmts);
+    emit(OpCode::HALT);
+    return std::move(out);
+}
+
+void Compiler::compileExpr(Expr *e)
+{
+    switch (e->kind)
+    {
+    case NodeKind::LITERAL:
+    {
+        auto lit = static_cast<LiteralExpr *>(e);
+        Value v;
+        if (lit->litKind == LiteralExpr::Kind::INTEGER)
+            v = Value::makeInt(lit->ival);
+        else if (lit->litKind == LiteralExpr::Kind::FLOAT)
+            v = Value::makeNum(lit->dval);
+        else if (lit->litKind == LiteralExpr::Kind::STRING)
+            v = Value::makeStr(out.strings->str(lit->sval));
+        else
+            v = Value::makeBool(lit->bval);
+        emit(OpCode::CONST, addConst(std::move(v)), 0, e->line);
+        return;
+    }
+    case NodeKind::IDENT:
+    {
+        auto id = static_cast<IdentExpr *>(e);
+        emit(OpCode::LOAD, addRef(id->name, id->binding, -1), 0, e->line);
+        return;
+    }
+    case NodeKind::UNARY:
+    {
+        auto u = static_cast<UnaryExpr *>(e);
+        compileExpr(u->rhs.get());
+        emit(u->op == UnaryOp::NOT ? OpCode::NOT : OpCode::NEG, 0, 0, e->line);
+        return;
+    }
+    case NodeKind::BINARY:
+    {
+        // Indexed by BinaryOp, up to the short-circuit operators
+        static const OpCode binaryOps[] = {OpCode::ADD, OpCode::SUB, OpCode::MUL, OpCode::DIV, OpCode::MOD, OpCode::EQ, OpCode::NEQ, OpCode::LT, OpCode::GT, OpCode::LE, OpCode::GE};
+        static_assert(sizeof(binaryOps) / sizeof(binaryOps[0]) == static_cast<size_t>(BinaryOp::AND), "one opcode per eager BinaryOp");
+
+        auto b = static_cast<BinaryExpr *>(e);
+        compileExpr(b->lhs.get());
+        if (b->op == BinaryOp::AND || b->op == BinaryOp::OR)
+        {
+            // The right operand only runs when the left one does not decide the result
+            size_t skip = emit(b->op == BinaryOp::AND ? OpCode::AND_JUMP : OpCode::OR_JUMP, 0, 0, e->line);
+            compileExpr(b->rhs.get());
+            emit(OpCode::TO_BOOL, 0, 0, e->line);
+            out.code[skip].a = here();
+            return;
+        }
+        compileExpr(b->rhs.get());
+        emit(binaryOps[static_cast<size_t>(b->op)], 0, 0, e->line);
+        return;
+    }
+    case NodeKind::CALL:
+        // 目前还不支持函数调用
+        emit(OpCode::FAIL, addMessage("Function calls not supported"), 0, e->line);
+        return;
+    case NodeKind::ACCESS:
+        // 目前还不支持成员访问
+        emit(OpCode::FAIL, addMessage("Member access not supported"), 0, e->line);
+        return;
+    default:
+        break;
+    }
+    throw std::runtime_error("Unknown expression node");
+}
+
+void Compiler::compileStmt(Stmt *s)
+{
+    switch (s->kind)
+    {
+    case NodeKind::EXPR_STMT:
+    {
+        // Evaluate and ignore
+        uint32_t begin = static_cast<uint32_t>(out.code.size());
+        compileExpr(static_cast<ExprStmt *>(s)->expr.get());
+        out.errorRanges.push_back(ErrorRange{begin, static_cast<uint32_t>(out.code.size()), s->line});
+        emit(OpCode::POP, 0, 0, s->line);
+        return;
+    }
+    case NodeKind::ASSIGN:
+    {
+        auto as = static_cast<AssignStmt *>(s);
+        compileExpr(as->expr.get());
+        emit(OpCode::STORE, addRef(as->name, as->binding, as->binding.own), 0, s->line);
+        return;
+    }
+    case NodeKind::DECL:
+        return compileDecl(static_cast<DeclStmt *>(s));
+    case NodeKind::IF:
+        return compileIf(static_cast<IfStmt *>(s));
+    case NodeKind::FOR:
+        return compileFor(static_cast<ForStmt *>(s));
+    case NodeKind::OBJ:
+        return compileObj(static_cast<ObjStmt *>(s));
+    case NodeKind::BREAK:
+        return compileLoopExit(static_cast<BreakStmt *>(s)->body, true, s->line);
+    case NodeKind::CONTINUE:
+        return compileLoopExit(static_cast<ContinueStmt *>(s)->body, false, s->line);
+    default:
+        break;
+    }
+    throw std::runtime_error("Unknown statement node");
+}
+
+void Compiler::compileBody(const std::vector<StmtPtr> &body)
+{
+    for (auto &st : body)
+        compileStmt(st.get());
+}
+
+void Compiler::compileBlock(const std::vector<StmtPtr> &body, int slots, int line)
+{
+    openScope(slots, line);
+    compileBody(body);
+    closeScope(line);
+}
+
+void Compiler::compileDecl(DeclStmt *ds)
+{
+    int ref = addRef(ds->name, VarBinding(), ds->slot);
+
+    if (!ds->initBlock.empty())
+    {
+        openScope(ds->initSlots, ds->line);
+
+        // The block result starts as the type default and is replaced by every expression statement
+        emit(OpCode::CONST, addConst(Value::makeDefault(ds->type)), 0, ds->line);
+        ++pending;
+
+        bool hasLastExpr = false;
+        for (size_t i = 0; i < ds->initBlock.size(); ++i)
+        {
+            Stmt *st = ds->initBlock[i].get();
+            bool isLastStmt = (i == ds->initBlock.size() - 1);
+
+            if (st->kind == NodeKind::EXPR_STMT)
+            {
+                compileExpr(static_cast<ExprStmt *>(st)->expr.get());
+                emit(OpCode::REPLACE, 0, 0, st->line);
+                hasLastExpr = true;
+            }
+            else if (isLastStmt && st->kind == NodeKind::IF)
+            {
+                compileIfWithReturn(static_cast<IfStmt *>(st));
+                emit(OpCode::REPLACE, 0, 0, st->line);
+                hasLastExpr = true;
+            }
+            else
+            {
+                compileStmt(st);
+            }
+        }
+
+        // Without an expression the last declared variable is the result
+        if (!hasLastExpr && !ds->result.candidates.empty())
+            emit(OpCode::LOAD_IF_SET, addRef(ds->name, ds->result, -1), 0, ds->line);
+
+        --pending;
+        closeScope(ds->line);
+    }
+    else if (ds->init.has_value())
+    {
+        compileExpr(ds->init->get());
+    }
+    else
+    {
+        emit(OpCode::CONST, addConst(Value::makeDefault(ds->type)), 0, ds->line);
+    }
+
+    emit(OpCode::DECL, ref, 0, ds->line);
+}
+
+void Compiler::compileIf(IfStmt *is)
+{
+    std::vector<size_t> exits;
+
+    compileExpr(is->cond.get());
+    size_t skip = emit(OpCode::JUMP_IF_FALSE, 0, 0, is->line);
+    compileBlock(is->thenBody, is->thenSlots, is->line);
+    exits.push_back(emit(OpCode::JUMP, 0, 0, is->line));
+    out.code[skip].a = here();
+
+    for (size_t i = 0; i < is->elifs.size(); ++i)
+    {
+        auto &elif = is->elifs[i];
+        compileExpr(elif.first.get());
+        skip = emit(OpCode::JUMP_IF_FALSE, 0, 0, elif.first->line);
+        compileBlock(elif.second, is->elifSlots[i], elif.first->line);
+        exits.push_back(emit(OpCode::JUMP, 0, 0, is->line));
+        out.code[skip].a = here();
+    }
+
+    if (!is->elseBody.empty())
+        compileBlock(is->elseBody, is->elseSlots, is->line);
+
+    for (size_t at : exits)
+        out.code[at].a = here();
+}
+
+void Compiler::compileFor(ForStmt *fs)
+{
+    for (auto &arg : fs->args)
+        compileExpr(arg.get());
+    emit(OpCode::FOR_PREP, static_cast<int>(fs->args.size()), 0, fs->line);
+
+    // The body runs directly in the loop scope, which also holds the iterator
+    openScope(fs->bodySlots, fs->line);
+
+    size_t next = emit(OpCode::FOR_NEXT, fs->iterSlot, 0, fs->line);
+    loops.push_back(Loop{scopeDepth, pending, objectDepth, next, {}});
+    compileBody(fs->body);
+    emit(OpCode::JUMP, static_cast<int>(next), 0, fs->line);
+
+    int exit = here();
+    out.code[next].b = exit;
+    for (size_t at : loops.back().breaks)
+        out.code[at].a = exit;
+    loops.pop_back();
+
+    emit(OpCode::FOR_END, 0, 0, fs->line);
+    closeScope(fs->line);
+}
+
+void Compiler::compileObj(ObjStmt *os)
+{
+    emit(OpCode::OBJ_BEGIN, static_cast<int>(os->className), 0, os->line);
+    compileExpr(os->idExpr.get());
+    emit(OpCode::OBJ_ID, 0, 0, os->line);
+
+    ++objectDepth;
+    compileBlock(os->body, os->bodySlots, os->line);
+    --objectDepth;
+
+    emit(OpCode::OBJ_END, 0, 0, os->line);
+}
+
+void Compiler::compileLoopExit(const std::vector<StmtPtr> &body, bool isBreak, int line)
+{
+    // 先执行 break/continue 语句块, 再跳出或进入下一次迭代
+    compileBody(body);
+
+    if (loops.empty())
+    {
+        emit(OpCode::FAIL, addMessage(isBreak ? "'break' outside of loop" : "'continue' outside of loop"), 0, line);
+        return;
+    }
+
+    Loop &loop = loops.back();
+    emitUnwind(loop, line);
+    if (isBreak)
+        loop.breaks.push_back(emit(OpCode::JUMP, 0, 0, line));
+    else
+        emit(OpCode::JUMP, static_cast<int>(loop.continueTarget), 0, line);
+}
+
+void Compiler::compileIfWithReturn(IfStmt *is)
+{
+    std::vector<size_t> exits;
+
+    compileExpr(is->cond.get());
+    size_t skip = emit(OpCode::JUMP_IF_FALSE, 0, 0, is->line);
+    compileBlockWithReturn(is->thenBody, is->thenSlots, is->line);
+    exits.push_back(emit(OpCode::JUMP, 0, 0, is->line));
+    out.code[skip].a = here();
+
+    for (size_t i = 0; i < is->elifs.size(); ++i)
+    {
+        auto &elif = is->elifs[i];
+        compileExpr(elif.first.get());
+        skip = emit(OpCode::JUMP_IF_FALSE, 0, 0, elif.first->line);
+        compileBlockWithReturn(elif.second, is->elifSlots[i], elif.first->line);
+        exits.push_back(emit(OpCode::JUMP, 0, 0, is->line));
+        out.code[skip].a = here();
+    }
+
+    // No matching condition, the value is 0.0
+    if (!is->elseBody.empty())
+        compileBlockWithReturn(is->elseBody, is->elseSlots, is->line);
+    else
+        emit(OpCode::CONST, addConst(Value::makeNum(0.0)), 0, is->line);
+
+    for (size_t at : exits)
+        out.code[at].a = here();
+}
+
+void Compiler::compileBlockWithReturn(const std::vector<StmtPtr> &body, int slots, int line)
+{
+    openScope(slots, line);
+    emit(OpCode::CONST, addConst(Value::makeNum(0.0)), 0, line);
+    ++pending;
+
+    for (size_t i = 0; i < body.size(); ++i)
+    {
+        Stmt *st = body[i].get();
+        if (i == body.size() - 1 && st->kind == NodeKind::EXPR_STMT)
+        {
+            // Last statement is an expression, it is the block's value
+            compileExpr(static_cast<ExprStmt *>(st)->expr.get());
+            emit(OpCode::REPLACE, 0, 0, st->line);
+        }
+        else
+        {
+            compileStmt(st);
+        }
+    }
+
+    --pending;
+    closeScope(line);
+}
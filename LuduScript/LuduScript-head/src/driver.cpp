@@ -0,0 +1,175 @@
+#include "driver.h"
+#include "columnar.h"
+#include "exec_cache.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "vm.h"
+#include "optimizer.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include <fstream>
+#include <memory>
+#include <ostream>
+
+namespace
+{
+    void writeProfile(const Profiler &profiler, const StringTable &strings, const std::string &path, std::ostream &err)
+    {
+        profiler.writeTable(err, strings);
+        std::ofstream ofs(path);
+        if (!ofs)
+        {
+            err << "Cannot write to " << path << std::endl;
+            return;
+        }
+        profiler.writeFlameGraph(ofs, strings);
+        err << "Profile saved to " << path << std::endl;
+    }
+}
+
+int runScript(std::string_view source, const RunOptions &opts, std::ostream &out, std::ostream &err)
+{
+    try
+    {
+        // A compiled program cached by an earlier run replaces lexing, parsing and optimising
+        std::unique_ptr<Program> program;
+        if (!opts.compileCache.empty())
+            program = ProgramCache(opts.compileCache).load(source);
+        if (!program)
+        {
+            Parser parser(source, opts.arena);
+            program = parser.parseProgram();
+            Optimizer().optimize(*program);
+            if (!opts.compileCache.empty() && !ProgramCache(opts.compileCache).store(source, *program))
+                err << "Cannot write to " << opts.compileCache << std::endl;
+        }
+
+        if (opts.dumpAst)
+        {
+            dumpAst(*program, out);
+            return 0;
+        }
+
+        FieldOrder order = opts.fieldOrder == "declared" ? FieldOrder::DECLARED : FieldOrder::SORTED;
+
+        // In stream mode objects go straight to the destination while the script runs
+        std::ofstream ofs;
+        std::unique_ptr<ObjectSink> sink;
+        if (!opts.stream.empty())
+        {
+            if (!opts.outputFile.empty())
+            {
+                ofs.open(opts.outputFile, std::ios::binary);
+                if (!ofs)
+                {
+                    err << "Cannot write to " << opts.outputFile << std::endl;
+                    return 3;
+                }
+            }
+            std::ostream &dest = opts.outputFile.empty() ? out : ofs;
+            auto framing = opts.stream == "ndjson" ? ObjectSink::Framing::NDJSON : ObjectSink::Framing::ARRAY;
+            sink = std::make_unique<ObjectSink>(dest, framing, opts.pretty, order);
+        }
+
+        // Generate output string
+        bool columnar = opts.format == "columnar";
+        std::string output;
+        if (opts.engine == "vm")
+        {
+            // Lower the AST to bytecode and run it on the stack VM
+            BytecodeProgram bytecode = Compiler().compile(*program);
+            VM vm;
+            vm.setSink(sink.get());
+            vm.setFieldOrder(order);
+            vm.execute(bytecode);
+            if (!sink)
+                output = columnar ? encodeColumnar(vm.getObjects(), *program->strings) : vm.getOutput(opts.pretty);
+        }
+        else
+        {
+            Interpreter interpreter;
+            interpreter.setSink(sink.get());
+            interpreter.setFieldOrder(order);
+            interpreter.setJobs(opts.jobs);
+
+            // Unchanged top-level statements are replayed from the previous run
+            ExecCache cache;
+            if (!opts.cacheFile.empty())
+            {
+                cache.load(opts.cacheFile);
+                interpreter.setCache(&cache);
+            }
+
+            Profiler profiler;
+            if (!opts.profile.empty())
+            {
+                if (!interpreter.setProfiler(&profiler))
+                {
+                    err << "Error: this build has no profiler (configure with -DLUDUSCRIPT_PROFILER=ON)" << std::endl;
+                    return 1;
+                }
+                profiler.start();
+                try
+                {
+                    interpreter.execute(program.get());
+                }
+                catch (...)
+                {
+                    profiler.stop();
+                    writeProfile(profiler, *program->strings, opts.profile, err);
+                    throw;
+                }
+                profiler.stop();
+                writeProfile(profiler, *program->strings, opts.profile, err);
+            }
+            else
+            {
+                interpreter.execute(program.get());
+            }
+            if (!sink)
+                output = columnar ? encodeColumnar(interpreter.getObjects(), *program->strings) : interpreter.getOutput(opts.pretty);
+
+            if (!opts.cacheFile.empty())
+            {
+                if (!cache.save(opts.cacheFile))
+                    err << "Cannot write to " << opts.cacheFile << std::endl;
+                err << "Incremental: " << cache.hits() << " of " << cache.hits() + cache.misses()
+                    << " top-level statements reused" << std::endl;
+            }
+        }
+
+        if (sink)
+        {
+            sink->finish();
+            if (!opts.outputFile.empty())
+                out << "Output saved to " << opts.outputFile << std::endl;
+            return 0;
+        }
+
+        // Output to file or console
+        if (!opts.outputFile.empty())
+        {
+            ofs.open(opts.outputFile, columnar ? std::ios::binary : std::ios::out);
+            if (!ofs)
+            {
+                err << "Cannot write to " << opts.outputFile << std::endl;
+                return 3;
+            }
+            if (columnar)
+                ofs.write(output.data(), static_cast<std::streamsize>(output.size()));
+            else
+                ofs << output << std::endl;
+            out << "Output saved to " << opts.outputFile << std::endl;
+        }
+        else
+        {
+            out << output << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception &ex)
+    {
+        err << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
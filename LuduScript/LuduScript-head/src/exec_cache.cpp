@@ -0,0 +1,371 @@
+#include "exec_cache.h"
+#include "json_writer.h"
+#include "source.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    // Bumped whenever the hashes, the entry layout or the language semantics change
+    constexpr int32_t kCacheFormat = 3;
+
+    constexpr char kMagic[4] = {'L', 'D', 'X', 'C'};
+
+    // FNV-1a, 64 bit; also collects the variable names of the hashed statement
+    struct Hasher
+    {
+        uint64_t h = 1469598103934665603ull;
+        std::vector<Symbol> *names = nullptr;
+
+        void name(Symbol id, const StringTable &strings)
+        {
+            str(strings.str(id));
+            if (std::find(names->begin(), names->end(), id) == names->end())
+                names->push_back(id);
+        }
+        void bytes(const void *p, size_t n)
+        {
+            auto c = static_cast<const unsigned char *>(p);
+            for (size_t i = 0; i < n; ++i)
+                h = (h ^ c[i]) * 1099511628211ull;
+        }
+        void u64(uint64_t v) { bytes(&v, sizeof(v)); }
+        void str(std::string_view s)
+        {
+            u64(s.size());
+            bytes(s.data(), s.size());
+        }
+    };
+
+    void hashStmt(Hasher &h, const Stmt *s, const StringTable &strings);
+
+    uint64_t checksum(std::string_view blob)
+    {
+        Hasher h;
+        h.bytes(blob.data(), blob.size());
+        return h.h;
+    }
+
+    void hashExpr(Hasher &h, const Expr *e, const StringTable &strings)
+    {
+        h.u64(static_cast<uint64_t>(e->kind));
+        switch (e->kind)
+        {
+        case NodeKind::LITERAL:
+        {
+            auto lit = static_cast<const LiteralExpr *>(e);
+            h.u64(static_cast<uint64_t>(lit->litKind));
+            if (lit->litKind == LiteralExpr::Kind::INTEGER)
+                h.u64(static_cast<uint64_t>(lit->ival));
+            else if (lit->litKind == LiteralExpr::Kind::FLOAT)
+                h.bytes(&lit->dval, sizeof(lit->dval));
+            else if (lit->litKind == LiteralExpr::Kind::STRING)
+                h.str(strings.str(lit->sval));
+            else
+                h.u64(lit->bval);
+            break;
+        }
+        case NodeKind::IDENT:
+            h.name(static_cast<const IdentExpr *>(e)->name, strings);
+            break;
+        case NodeKind::UNARY:
+        {
+            auto u = static_cast<const UnaryExpr *>(e);
+            h.u64(static_cast<uint64_t>(u->op));
+            hashExpr(h, u->rhs.get(), strings);
+            break;
+        }
+        case NodeKind::BINARY:
+        {
+            auto b = static_cast<const BinaryExpr *>(e);
+            h.u64(static_cast<uint64_t>(b->op));
+            hashExpr(h, b->lhs.get(), strings);
+            hashExpr(h, b->rhs.get(), strings);
+            break;
+        }
+        case NodeKind::CALL:
+        {
+            auto c = static_cast<const CallExpr *>(e);
+            hashExpr(h, c->callee.get(), strings);
+            h.u64(c->args.size());
+            for (auto &arg : c->args)
+                hashExpr(h, arg.get(), strings);
+            break;
+        }
+        case NodeKind::ACCESS:
+        {
+            auto a = static_cast<const AccessExpr *>(e);
+            hashExpr(h, a->target.get(), strings);
+            h.str(strings.str(a->member));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void hashBody(Hasher &h, const std::vector<StmtPtr> &body, const StringTable &strings)
+    {
+        h.u64(body.size());
+        for (auto &st : body)
+            hashStmt(h, st.get(), strings);
+    }
+
+    void hashStmt(Hasher &h, const Stmt *s, const StringTable &strings)
+    {
+        h.u64(static_cast<uint64_t>(s->kind));
+        switch (s->kind)
+        {
+        case NodeKind::EXPR_STMT:
+            hashExpr(h, static_cast<const ExprStmt *>(s)->expr.get(), strings);
+            break;
+        case NodeKind::ASSIGN:
+        {
+            auto as = static_cast<const AssignStmt *>(s);
+            h.name(as->name, strings);
+            hashExpr(h, as->expr.get(), strings);
+            break;
+        }
+        case NodeKind::DECL:
+        {
+            auto ds = static_cast<const DeclStmt *>(s);
+            h.str(ds->type);
+            h.name(ds->name, strings);
+            h.u64(ds->init.has_value());
+            if (ds->init.has_value())
+                hashExpr(h, ds->init->get(), strings);
+            hashBody(h, ds->initBlock, strings);
+            break;
+        }
+        case NodeKind::IF:
+        {
+            auto is = static_cast<const IfStmt *>(s);
+            hashExpr(h, is->cond.get(), strings);
+            hashBody(h, is->thenBody, strings);
+            h.u64(is->elifs.size());
+            for (auto &elif : is->elifs)
+            {
+                hashExpr(h, elif.first.get(), strings);
+                hashBody(h, elif.second, strings);
+            }
+            hashBody(h, is->elseBody, strings);
+            break;
+        }
+        case NodeKind::FOR:
+        {
+            auto fs = static_cast<const ForStmt *>(s);
+            h.name(fs->iter, strings);
+            h.u64(fs->args.size());
+            for (auto &arg : fs->args)
+                hashExpr(h, arg.get(), strings);
+            hashBody(h, fs->body, strings);
+            break;
+        }
+        case NodeKind::OBJ:
+        {
+            auto os = static_cast<const ObjStmt *>(s);
+            h.str(strings.str(os->className));
+            hashExpr(h, os->idExpr.get(), strings);
+            hashBody(h, os->body, strings);
+            break;
+        }
+        case NodeKind::BREAK:
+            hashBody(h, static_cast<const BreakStmt *>(s)->body, strings);
+            break;
+        case NodeKind::CONTINUE:
+            hashBody(h, static_cast<const ContinueStmt *>(s)->body, strings);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+uint64_t ExecCache::hashStmt(const Stmt *s, const StringTable &strings, std::vector<Symbol> &names)
+{
+    names.clear();
+    Hasher h;
+    h.names = &names;
+    ::hashStmt(h, s, strings);
+    return h.h;
+}
+
+uint64_t ExecCache::hashGlobal(std::string_view name, const Value &v)
+{
+    Hasher h;
+    h.str(name);
+    // int and float payloads hash differently, as 1 and 1.0 print differently
+    h.u64(v.isInt() ? 0 : v.isFloat() ? 1 : static_cast<uint64_t>(v.type()) + 2);
+    if (v.isStr())
+        h.str(v.strVal());
+    else if (v.isInt())
+        h.u64(static_cast<uint64_t>(v.intVal()));
+    else if (v.isFloat())
+    {
+        double d = v.numVal();
+        h.bytes(&d, sizeof(d));
+    }
+    else
+        h.u64(v.boolVal());
+    return h.h;
+}
+
+void ExecCache::load(const std::string &path)
+{
+    entries.clear();
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+        return;
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    int32_t format = 0;
+    if (data.size() < 8 || std::memcmp(data.data(), kMagic, 4) != 0)
+        return;
+    std::memcpy(&format, data.data() + 4, 4);
+    if (format != kCacheFormat)
+        return;
+
+    size_t pos = 8;
+    while (pos + 28 <= data.size())
+    {
+        uint64_t stmt, state, sum;
+        uint32_t len;
+        std::memcpy(&stmt, data.data() + pos, 8);
+        std::memcpy(&state, data.data() + pos + 8, 8);
+        std::memcpy(&len, data.data() + pos + 16, 4);
+        std::memcpy(&sum, data.data() + pos + 20, 8);
+        pos += 28;
+        if (len > data.size() - pos)
+            break; // truncated; keep what was read
+        std::string_view blob(data.data() + pos, len);
+        if (checksum(blob) != sum)
+        {
+            entries.clear();
+            return;
+        }
+        entries[{stmt, state}].blob.assign(blob);
+        pos += len;
+    }
+}
+
+bool ExecCache::save(const std::string &path) const
+{
+    bool stale = std::any_of(entries.begin(), entries.end(), [](const auto &e)
+                             { return !e.second.used; });
+    if (!changed && !stale)
+        return true;
+
+    // Built in memory and swapped in whole, so a crash or a concurrent run never leaves half a file
+    std::string data(kMagic, 4);
+    data.append(reinterpret_cast<const char *>(&kCacheFormat), 4);
+    for (auto &[key, c] : entries)
+    {
+        if (!c.used)
+            continue;
+        uint32_t len = static_cast<uint32_t>(c.blob.size());
+        uint64_t sum = checksum(c.blob);
+        data.append(reinterpret_cast<const char *>(&key.first), 8);
+        data.append(reinterpret_cast<const char *>(&key.second), 8);
+        data.append(reinterpret_cast<const char *>(&len), 4);
+        data.append(reinterpret_cast<const char *>(&sum), 8);
+        data += c.blob;
+    }
+    return replaceFile(path, data);
+}
+
+namespace
+{
+    bool decodeValue(const json &j, Value &out)
+    {
+        try
+        {
+            out = Value::fromJson(j);
+            return true;
+        }
+        catch (const std::runtime_error &)
+        {
+            return false;
+        }
+    }
+
+    bool decodeObjects(const json &doc, const StringTable &strings, ObjectList &objects)
+    {
+        objects.clear();
+        NativeObject native;
+        for (auto &obj : doc)
+        {
+            if (!obj.is_array())
+                return false;
+            native.fields.clear();
+            for (auto &field : obj)
+            {
+                Symbol k;
+                if (!field.is_array() || field.size() != 2 || !field[0].is_string() ||
+                    !strings.find(field[0].get_ref<const std::string &>(), k))
+                    return false;
+                Value value;
+                if (!decodeValue(field[1], value))
+                    return false;
+                native.fields.push_back({k, false, std::move(value)});
+            }
+            objects.push(native.view());
+        }
+        return true;
+    }
+}
+
+bool ExecCache::find(uint64_t stmt, uint64_t state, const StringTable &strings, Entry &out)
+{
+    auto it = entries.find({stmt, state});
+    if (it != entries.end())
+    {
+        json doc = json::parse(it->second.blob, nullptr, false);
+        // Globals are checked here too, so a hit never fails halfway through its replay
+        Value v;
+        if (doc.is_array() && doc.size() == 2 && doc[0].is_object() && doc[1].is_array() &&
+            std::all_of(doc[0].begin(), doc[0].end(), [&](const json &g)
+                        { return decodeValue(g, v); }) &&
+            decodeObjects(doc[1], strings, out.objects))
+        {
+            out.globals = std::move(doc[0]);
+            it->second.used = true;
+            ++hitCount;
+            return true;
+        }
+        entries.erase(it); // damaged, rerun the statement and store it again
+    }
+    ++missCount;
+    return false;
+}
+
+void ExecCache::store(uint64_t stmt, uint64_t state, const StringTable &strings, const Entry &entry)
+{
+    Cached &c = entries[{stmt, state}];
+    c.blob = "[" + entry.globals.dump() + ",[";
+    for (size_t i = 0; i < entry.objects.size(); ++i)
+    {
+        c.blob += i > 0 ? ",[" : "[";
+        ObjectView obj = entry.objects[i];
+        for (size_t f = 0; f < obj.size(); ++f)
+        {
+            c.blob += f > 0 ? ",[" : "[";
+            JsonWriter::writeString(c.blob, strings.str(obj[f].key));
+            c.blob += ',';
+            const Value &v = obj[f].value;
+            // writeValue prints non-finite doubles as null and throws on strings that are not UTF-8
+            if ((v.isFloat() && !std::isfinite(v.numVal())) || (v.isStr() && !JsonWriter::isUtf8(v.strVal())))
+                c.blob += v.toJson().dump();
+            else
+                JsonWriter::writeValue(c.blob, v);
+            c.blob += ']';
+        }
+        c.blob += ']';
+    }
+    c.blob += "]]";
+    c.used = true;
+    changed = true;
+}
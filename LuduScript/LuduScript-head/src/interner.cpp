@@ -0,0 +1,28 @@
+#include "interner.h"
+
+StringTable::StringTable()
+{
+    // Must match the order of the sym enum
+    for (const char *s : {"class", "id"})
+        intern(s);
+}
+
+Symbol StringTable::intern(std::string_view s)
+{
+    auto it = index.find(s);
+    if (it != index.end())
+        return it->second;
+    strings.emplace_back(s);
+    Symbol id = static_cast<Symbol>(strings.size() - 1);
+    index.emplace(strings.back(), id);
+    return id;
+}
+
+bool StringTable::find(std::string_view s, Symbol &id) const
+{
+    auto it = index.find(s);
+    if (it == index.end())
+        return false;
+    id = it->second;
+    return true;
+}
@@ -1,6 +1,11 @@
 #include "interpreter.h"
+#include "exec_cache.h"
+#include "json_writer.h"
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 void use(Expr e)
 {
@@ -8,333 +13,720 @@ void use(Expr e)
 }
 
 // Value implementation
+Value::Value(const Value &o)
+{
+    std::memcpy(bytes, o.bytes, sizeof(bytes));
+    retain();
+}
+
+Value::Value(Value &&o) noexcept
+{
+    std::memcpy(bytes, o.bytes, sizeof(bytes));
+    o.setScalar(TAG_INT, ll(0));
+}
+
+Value &Value::operator=(const Value &o)
+{
+    if (this != &o)
+    {
+        o.retain();
+        release();
+        std::memcpy(bytes, o.bytes, sizeof(bytes));
+    }
+    return *this;
+}
+
+Value &Value::operator=(Value &&o) noexcept
+{
+    if (this != &o)
+    {
+        release();
+        std::memcpy(bytes, o.bytes, sizeof(bytes));
+        o.setScalar(TAG_INT, ll(0));
+    }
+    return *this;
+}
+
+void Value::retain() const
+{
+    if (isHeapStr())
+        heap()->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Value::release()
+{
+    if (isHeapStr())
+    {
+        HeapStr *h = heap();
+        if (h->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            h->~HeapStr();
+            ::operator delete(h);
+        }
+    }
+}
+
+Value Value::allocStr(size_t size, char *&data)
+{
+    Value v;
+    if (size <= kInlineCap)
+    {
+        v.bytes[14] = static_cast<unsigned char>(size);
+        v.bytes[15] = TAG_STR;
+        data = reinterpret_cast<char *>(v.bytes);
+        return v;
+    }
+    void *mem = ::operator new(sizeof(HeapStr) + size);
+    HeapStr *h = new (mem) HeapStr;
+    h->refs.store(1, std::memory_order_relaxed);
+    h->size = size;
+    v.setScalar(TAG_STR, h);
+    v.bytes[14] = kHeapLen;
+    data = h->data();
+    return v;
+}
+
 Value Value::makeInt(ll i)
 {
+    // Integers keep the precision of the double every number used to be stored in, so values
+    // past 2^53 round (and print) exactly as they always have
+    constexpr ll kExact = ll(1) << 53;
+    if (i > kExact || i < -kExact)
+    {
+        double d = static_cast<double>(i);
+        // 2^63 itself does not fit back into ll; the old conversion produced LLONG_MIN there
+        i = d >= 9223372036854775808.0 ? std::numeric_limits<ll>::min() : static_cast<ll>(d);
+    }
     Value v;
-    v.type = Type::NUM;
-    v.nval = static_cast<double>(i);
-    v.isInteger = true;
+    v.setScalar(TAG_INT, i);
     return v;
 }
 
 Value Value::makeNum(double n)
 {
     Value v;
-    v.type = Type::NUM;
-    v.nval = n;
-    v.isInteger = false;
+    v.setScalar(TAG_FLOAT, n);
     return v;
 }
 
-Value Value::makeStr(std::string s)
+Value Value::makeStr(std::string_view s)
 {
-    Value x;
-    x.type = Type::STR;
-    x.sval = std::move(s);
+    char *data;
+    Value x = allocStr(s.size(), data);
+    if (!s.empty())
+        std::memcpy(data, s.data(), s.size());
+    return x;
+}
+
+Value Value::concat(std::string_view a, std::string_view b)
+{
+    char *data;
+    Value x = allocStr(a.size() + b.size(), data);
+    if (!a.empty())
+        std::memcpy(data, a.data(), a.size());
+    if (!b.empty())
+        std::memcpy(data + a.size(), b.data(), b.size());
     return x;
 }
 
 Value Value::makeBool(bool b)
 {
     Value x;
-    x.type = Type::BOOL;
-    x.bval = b;
+    x.setScalar(TAG_BOOL, b);
     return x;
 }
 
+std::string_view Value::strVal() const
+{
+    if (isHeapStr())
+        return std::string_view(heap()->data(), heap()->size);
+    return std::string_view(reinterpret_cast<const char *>(bytes), bytes[14]);
+}
+
 std::string Value::toStr() const
 {
-    if (type == Type::STR)
-        return sval;
-    if (type == Type::NUM)
+    switch (tag())
     {
-        if (isInteger)
-            return std::to_string(static_cast<ll>(nval));
-        else
-            return std::to_string(nval);
+    case TAG_STR:
+        return std::string(strVal());
+    case TAG_INT:
+        return std::to_string(intVal());
+    case TAG_FLOAT:
+        return std::to_string(load<double>());
+    case TAG_BOOL:
+        return boolVal() ? "true" : "false";
     }
-    if (type == Type::BOOL)
-        return bval ? "true" : "false";
     return "";
 }
 
 double Value::toNum() const
 {
-    if (type == Type::NUM)
-        return nval;
-    if (type == Type::STR)
+    switch (tag())
     {
+    case TAG_INT:
+        return static_cast<double>(intVal());
+    case TAG_FLOAT:
+        return load<double>();
+    case TAG_STR:
         try
         {
-            return std::stod(sval);
+            return std::stod(std::string(strVal()));
         }
         catch (...)
         {
             return 0.0;
         }
+    case TAG_BOOL:
+        return boolVal() ? 1.0 : 0.0;
     }
-    if (type == Type::BOOL)
-        return bval ? 1.0 : 0.0;
     return 0.0;
 }
 
 ll Value::toInt() const
 {
-    if (type == Type::NUM)
-        return static_cast<ll>(nval);
-    if (type == Type::STR)
+    switch (tag())
     {
+    case TAG_INT:
+        return intVal();
+    case TAG_FLOAT:
+        return static_cast<ll>(load<double>());
+    case TAG_STR:
         try
         {
-            return std::stoll(sval);
+            return std::stoll(std::string(strVal()));
         }
         catch (...)
         {
             return 0;
         }
+    case TAG_BOOL:
+        return boolVal() ? 1 : 0;
     }
-    if (type == Type::BOOL)
-        return bval ? 1 : 0;
     return 0;
 }
 
 bool Value::toBool() const
 {
-    if (type == Type::BOOL)
-        return bval;
-    if (type == Type::NUM)
-        return nval != 0.0;
-    if (type == Type::STR)
-        return !sval.empty();
+    switch (tag())
+    {
+    case TAG_BOOL:
+        return boolVal();
+    case TAG_INT:
+        return intVal() != 0;
+    case TAG_FLOAT:
+        return load<double>() != 0.0;
+    case TAG_STR:
+        return !strVal().empty();
+    }
     return false;
 }
 
-bool Value::isInt() const
+Value Value::makeDefault(const std::string &type)
 {
-    return type == Type::NUM && isInteger;
+    if (type == "str")
+        return makeStr("");
+    if (type == "bool")
+        return makeBool(false);
+    return makeNum(0.0);
 }
 
-// Env implementation
-void Env::pushScope()
+json Value::toJson() const
 {
-    stack.emplace_back();
+    switch (tag())
+    {
+    case TAG_INT:
+        return json(intVal());
+    case TAG_FLOAT:
+    {
+        double d = load<double>();
+        if (std::isfinite(d))
+            return json(d);
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(d));
+        return json::array({bits});
+    }
+    case TAG_BOOL:
+        return json(boolVal());
+    case TAG_STR:
+        break;
+    }
+    std::string_view s = strVal();
+    if (JsonWriter::isUtf8(s))
+        return json(std::string(s));
+    static const char hex[] = "0123456789abcdef";
+    std::string bytes;
+    bytes.reserve(s.size() * 2);
+    for (unsigned char c : s)
+    {
+        bytes += hex[c >> 4];
+        bytes += hex[c & 0xF];
+    }
+    return json::array({bytes});
 }
 
-void Env::popScope()
+Value Value::fromJson(const json &j)
+{
+    if (j.is_number_integer())
+        return makeInt(j.get<ll>());
+    if (j.is_number())
+        return makeNum(j.get<double>());
+    if (j.is_boolean())
+        return makeBool(j.get<bool>());
+    if (j.is_string())
+        return makeStr(j.get_ref<const std::string &>());
+    if (j.is_array() && j.size() == 1 && j[0].is_number_unsigned())
+    {
+        uint64_t bits = j[0].get<uint64_t>();
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        if (!std::isfinite(d))
+            return makeNum(d);
+    }
+    if (j.is_array() && j.size() == 1 && j[0].is_string() && j[0].get_ref<const std::string &>().size() % 2 == 0)
+    {
+        auto digit = [](char c)
+        { return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1; };
+        const std::string &hex = j[0].get_ref<const std::string &>();
+        std::string bytes;
+        bytes.reserve(hex.size() / 2);
+        for (size_t i = 0; i < hex.size(); i += 2)
+        {
+            int hi = digit(hex[i]), lo = digit(hex[i + 1]);
+            if (hi < 0 || lo < 0)
+                throw std::runtime_error("Not a scalar JSON value");
+            bytes += static_cast<char>(hi << 4 | lo);
+        }
+        return makeStr(bytes);
+    }
+    throw std::runtime_error("Not a scalar JSON value");
+}
+
+// Operator implementation
+namespace ops
+{
+    Value add(const Value &L, const Value &R)
+    {
+        // If both are integers, return integer
+        if (L.isInt() && R.isInt())
+            return Value::makeInt(L.intVal() + R.intVal());
+        // Same-type fast paths: str+str needs no conversion, float+float no toNum dispatch
+        if (L.isStr() && R.isStr())
+            return Value::concat(L.strVal(), R.strVal());
+        if (L.isFloat() && R.isFloat())
+            return Value::makeNum(L.numVal() + R.numVal());
+        // If either is string, do string concat
+        if (L.isStr() || R.isStr())
+        {
+            std::string lt, rt;
+            std::string_view ls = L.isStr() ? L.strVal() : std::string_view(lt = L.toStr());
+            std::string_view rs = R.isStr() ? R.strVal() : std::string_view(rt = R.toStr());
+            return Value::concat(ls, rs);
+        }
+        // Otherwise return float
+        return Value::makeNum(L.toNum() + R.toNum());
+    }
+
+    Value sub(const Value &L, const Value &R)
+    {
+        if (L.isInt() && R.isInt())
+            return Value::makeInt(L.intVal() - R.intVal());
+        return Value::makeNum(L.toNum() - R.toNum());
+    }
+
+    Value mul(const Value &L, const Value &R)
+    {
+        if (L.isInt() && R.isInt())
+            return Value::makeInt(L.intVal() * R.intVal());
+        return Value::makeNum(L.toNum() * R.toNum());
+    }
+
+    Value div(const Value &L, const Value &R)
+    {
+        // Division always returns float to handle fractional results
+        double r = R.toNum();
+        if (r == 0.0)
+            throw std::runtime_error("Division by zero");
+        return Value::makeNum(L.toNum() / r);
+    }
+
+    Value mod(const Value &L, const Value &R)
+    {
+        ll r = R.toInt();
+        if (r == 0)
+            throw std::runtime_error("Modulo by zero");
+        return Value::makeNum(static_cast<double>(L.toInt() % r));
+    }
+
+    // Same-type equality; numbers compare by value regardless of int/float
+    static bool sameTypeEqual(const Value &L, const Value &R)
+    {
+        switch (L.type())
+        {
+        case Value::Type::NUM:
+            if (L.isInt() && R.isInt())
+                return L.intVal() == R.intVal();
+            return L.numVal() == R.numVal();
+        case Value::Type::STR:
+            return L.strVal() == R.strVal();
+        case Value::Type::BOOL:
+            return L.boolVal() == R.boolVal();
+        }
+        return false;
+    }
+
+    Value eq(const Value &L, const Value &R)
+    {
+        return Value::makeBool(L.type() == R.type() && sameTypeEqual(L, R));
+    }
+
+    Value neq(const Value &L, const Value &R)
+    {
+        return Value::makeBool(L.type() != R.type() || !sameTypeEqual(L, R));
+    }
+
+    Value lt(const Value &L, const Value &R) { return Value::makeBool(L.toNum() < R.toNum()); }
+    Value gt(const Value &L, const Value &R) { return Value::makeBool(L.toNum() > R.toNum()); }
+    Value le(const Value &L, const Value &R) { return Value::makeBool(L.toNum() <= R.toNum()); }
+    Value ge(const Value &L, const Value &R) { return Value::makeBool(L.toNum() >= R.toNum()); }
+    Value logicalAnd(const Value &L, const Value &R) { return Value::makeBool(L.toBool() && R.toBool()); }
+    Value logicalOr(const Value &L, const Value &R) { return Value::makeBool(L.toBool() || R.toBool()); }
+
+    Value negate(const Value &r) { return Value::makeNum(-r.toNum()); }
+    Value logicalNot(const Value &r) { return Value::makeBool(!r.toBool()); }
+
+    const BinaryFn binaryTable[] = {add, sub, mul, div, mod, eq, neq, lt, gt, le, ge, logicalAnd, logicalOr};
+}
+
+// Env implementation
+void Env::pushScope(int size)
 {
-    if (!stack.empty())
-        stack.pop_back();
+    frames.push_back(slots.size());
+    slots.resize(slots.size() + size);
+    slotSet.resize(slotSet.size() + size, 0);
 }
 
-void Env::setVar(const std::string &k, const Value &v)
+void Env::popScope()
 {
-    if (stack.empty())
-        pushScope();
-    stack.back()[k] = v;
+    slots.resize(frames.back());
+    slotSet.resize(frames.back());
+    frames.pop_back();
 }
 
-std::optional<Value> Env::getVar(const std::string &k)
+Value *Env::findVar(const Slot *candidates, size_t count)
 {
-    for (int i = int(stack.size()) - 1; i >= 0; --i)
+    for (size_t i = 0; i < count; ++i)
     {
-        auto it = stack[i].find(k);
-        if (it != stack[i].end())
-            return it->second;
+        size_t idx = frames[candidates[i].depth] + candidates[i].index;
+        if (slotSet[idx])
+            return &slots[idx];
     }
-    return std::nullopt;
+    return nullptr;
 }
 
-// Interpreter implementation
-void Interpreter::execute(Program *program)
+void Env::setLocal(int slot, Value v)
 {
-    for (auto &stmt : program->stmts)
+    size_t idx = frames.back() + slot;
+    slots[idx] = std::move(v);
+    slotSet[idx] = 1;
+}
+
+void Env::beginObject(Symbol className)
+{
+    if (openObjects == objects.size())
+        objects.emplace_back();
+    NativeObject &obj = objects[openObjects++];
+    obj.fields.clear();
+    obj.fields.push_back({sym::CLASS, false, Value::makeStr(strings->str(className))});
+}
+
+void Env::setObjectId(const Value &id)
+{
+    // ID as int if int, num if num, else string
+    if (id.type() == Value::Type::NUM)
+        currentObject().fields.push_back({sym::ID, false, id});
+    else
+        currentObject().fields.push_back({sym::ID, false, Value::makeStr(id.toStr())});
+}
+
+void Env::endObject()
+{
+    emit(currentObject().view());
+    abortObject();
+}
+
+void Env::emit(ObjectView obj)
+{
+    if (capture)
+        capture->push(obj);
+    if (sink)
+        sink->write(obj, *strings);
+    else
+        output.push(obj);
+}
+
+void Env::emit(ObjectList &&objects)
+{
+    if (!capture && !sink)
     {
-        execStmt(stmt.get());
+        output.append(std::move(objects));
+        return;
     }
+    for (size_t i = 0; i < objects.size(); ++i)
+        emit(objects[i]);
 }
 
-std::string Interpreter::getOutput(bool pretty) const
+void Env::abortObject()
 {
-    if (pretty)
-        return env.output.dump(2);
-    else
-        return env.output.dump();
+    // The enclosing object, if any, becomes current again
+    --openObjects;
 }
 
-Value Interpreter::evalExpr(Expr *e)
+void Env::declareField(Symbol k, const Value &v)
 {
-    if (auto lit = dynamic_cast<LiteralExpr *>(e))
-        return evalLiteral(lit);
-    if (auto id = dynamic_cast<IdentExpr *>(e))
-        return evalIdent(id);
-    if (auto u = dynamic_cast<UnaryExpr *>(e))
-        return evalUnary(u);
-    if (auto b = dynamic_cast<BinaryExpr *>(e))
-        return evalBinary(b);
-    if (auto c = dynamic_cast<CallExpr *>(e))
-        return evalCall(c);
-    if (auto a = dynamic_cast<AccessExpr *>(e))
-        return evalAccess(a);
-    throw std::runtime_error("Unknown expression node");
+    currentObject().set(k, v, true);
 }
 
-Value Interpreter::evalLiteral(LiteralExpr *lit)
+void Env::assignField(Symbol k, const Value &v)
 {
-    if (lit->kind == LiteralExpr::Kind::INTEGER)
-        return Value::makeInt(lit->ival);
-    if (lit->kind == LiteralExpr::Kind::FLOAT)
-        return Value::makeNum(lit->dval);
-    if (lit->kind == LiteralExpr::Kind::STRING)
-        return Value::makeStr(lit->sval);
-    if (lit->kind == LiteralExpr::Kind::BOOL)
-        return Value::makeBool(lit->bval);
+    // Assigning to an undeclared name creates the field; "class"/"id" stay undeclared
+    currentObject().set(k, v, k != sym::CLASS && k != sym::ID);
+}
 
-    // 默认返回值，不应该到达这里
-    throw std::runtime_error("Unknown literal kind");
+std::optional<Value> Env::lookupField(Symbol k) const
+{
+    if (!inObject())
+        return std::nullopt;
+
+    // Undeclared names inside an object evaluate to the name itself
+    const NativeObject::Field *f = currentObject().find(k);
+    if (!f || !f->declared)
+        return Value::makeStr(strings->str(k));
+
+    // Numbers read back the way a JSON number would: integral values come back as integers
+    if (f->value.type() == Value::Type::NUM)
+    {
+        double val = f->value.numVal();
+        if (val == std::floor(val))
+            return Value::makeInt(static_cast<ll>(val));
+        return Value::makeNum(val);
+    }
+    return f->value;
 }
 
-Value Interpreter::evalIdent(IdentExpr *id)
+std::string Env::serialize(bool pretty) const
 {
-    // First try to get variable from environment
-    auto val = env.getVar(id->name);
-    if (val.has_value())
-        return *val;
+    if (output.empty())
+        return "[]";
+    std::string out;
+    JsonWriter(*strings, pretty, fieldOrder).writeArray(out, output);
+    return out;
+}
+
+// NativeObject and ObjectView implementation
+NativeObject::Field *NativeObject::find(Symbol k)
+{
+    for (auto &f : fields)
+        if (f.key == k)
+            return &f;
+    return nullptr;
+}
+
+const ObjectField *ObjectView::find(Symbol k) const
+{
+    for (auto &f : *this)
+        if (f.key == k)
+            return &f;
+    return nullptr;
+}
 
-    // If in object context, try to get field value from current object
-    if (env.current_object.has_value() && env.declared_fields.find(id->name) != env.declared_fields.end())
+void NativeObject::set(Symbol k, const Value &v, bool declare)
+{
+    if (Field *f = find(k))
     {
-        auto &obj = *env.current_object;
-        if (obj.contains(id->name))
-        {
-            auto &field = obj[id->name];
-            if (field.is_number())
-            {
-                double val = field.get<double>();
-                if (val == std::floor(val))
-                    return Value::makeInt(static_cast<ll>(val));
-                else
-                    return Value::makeNum(val);
-            }
-            else if (field.is_string())
-                return Value::makeStr(field.get<std::string>());
-            else if (field.is_boolean())
-                return Value::makeBool(field.get<bool>());
-        }
+        f->value = v;
+        f->declared = f->declared || declare;
     }
+    else
+        fields.push_back({k, declare, v});
+}
 
-    // If in object context and variable not found, treat as field name
-    if (env.current_object.has_value() && env.declared_fields.find(id->name) == env.declared_fields.end())
+// ObjectList implementation
+void ObjectList::append(ObjectList &&o)
+{
+    if (ends.empty())
     {
-        return Value::makeStr(id->name);
+        fields.swap(o.fields);
+        ends.swap(o.ends);
+        o.clear();
+        return;
     }
+    size_t base = fields.size();
+    fields.insert(fields.end(), std::make_move_iterator(o.fields.begin()), std::make_move_iterator(o.fields.end()));
+    for (size_t end : o.ends)
+        ends.push_back(base + end);
+    o.clear();
+}
 
-    throw std::runtime_error("Undefined variable: " + id->name);
+// Interpreter implementation
+void Interpreter::execute(const Program *program)
+{
+    // The global scope always exists
+    env.strings = program->strings.get();
+    env.pushScope(program->globalSlots);
+    if (cache)
+    {
+        globalSlotOf.assign(program->strings->size(), -1);
+        for (int slot = 0; slot < program->globalSlots; ++slot)
+            globalSlotOf[program->globalNames[slot]] = slot;
+    }
+    for (auto &stmt : program->stmts)
+    {
+        if (cache)
+            execTopLevelCached(stmt.get(), *program);
+        else
+            execTopLevel(stmt.get());
+    }
 }
 
-Value Interpreter::evalUnary(UnaryExpr *u)
+void Interpreter::execTopLevel(Stmt *s)
 {
-    Value r = evalExpr(u->rhs.get());
-    if (u->op == "!")
-        return Value::makeBool(!r.toBool());
-    if (u->op == "-")
-        return Value::makeNum(-r.toNum());
-    throw std::runtime_error("Unknown unary operator: " + u->op);
+    if (jobs > 1 && s->kind == NodeKind::FOR && execForParallel(static_cast<ForStmt *>(s)))
+        return;
+    Flow flow = execStmt(s);
+    if (flow != Flow::NORMAL)
+        throw std::runtime_error(flow == Flow::BREAK ? "'break' outside of loop" : "'continue' outside of loop");
 }
 
-Value Interpreter::evalBinary(BinaryExpr *b)
+void Interpreter::execTopLevelCached(Stmt *s, const Program &program)
 {
-    Value L = evalExpr(b->lhs.get());
-    Value R = evalExpr(b->rhs.get());
-    const std::string &op = b->op;
+    const StringTable &strings = *program.strings;
+    std::vector<Symbol> names;
+    uint64_t stmtHash = ExecCache::hashStmt(s, strings, names);
+    uint64_t stateHash = hashGlobals(names, strings);
 
-    if (op == "+")
+    ExecCache::Entry entry;
+    if (cache->find(stmtHash, stateHash, strings, entry))
     {
-        // If either is string, do string concat
-        if (L.type == Value::Type::STR || R.type == Value::Type::STR)
-            return Value::makeStr(L.toStr() + R.toStr());
-        // If both are integers, return integer
-        if (L.type == Value::Type::NUM && R.type == Value::Type::NUM && L.isInteger && R.isInteger)
+        env.emit(std::move(entry.objects));
+        for (Symbol name : names)
         {
-            return Value::makeInt(static_cast<ll>(L.nval) + static_cast<ll>(R.nval));
+            auto it = entry.globals.find(strings.str(name));
+            if (it != entry.globals.end() && globalSlotOf[name] >= 0)
+                env.setLocal(globalSlotOf[name], Value::fromJson(*it));
         }
-        // Otherwise return float
-        return Value::makeNum(L.toNum() + R.toNum());
+        return;
     }
-    if (op == "-")
+
+    env.capture = &entry.objects;
+    try
     {
-        // If both are integers, return integer
-        if (L.type == Value::Type::NUM && R.type == Value::Type::NUM && L.isInteger && R.isInteger)
-        {
-            return Value::makeInt(static_cast<ll>(L.nval) - static_cast<ll>(R.nval));
-        }
-        // Otherwise return float
-        return Value::makeNum(L.toNum() - R.toNum());
+        execTopLevel(s);
     }
-    if (op == "*")
+    catch (...)
     {
-        // If both are integers, return integer
-        if (L.type == Value::Type::NUM && R.type == Value::Type::NUM && L.isInteger && R.isInteger)
-        {
-            return Value::makeInt(static_cast<ll>(L.nval) * static_cast<ll>(R.nval));
-        }
-        // Otherwise return float
-        return Value::makeNum(L.toNum() * R.toNum());
+        env.capture = nullptr;
+        throw;
     }
-    if (op == "/")
+    env.capture = nullptr;
+
+    for (Symbol name : names)
     {
-        // Division always returns float to handle fractional results
-        double r = R.toNum();
-        if (r == 0.0)
-            throw std::runtime_error("Division by zero");
-        return Value::makeNum(L.toNum() / r);
+        int slot = globalSlotOf[name];
+        if (slot >= 0 && env.slotSet[slot])
+            entry.globals[strings.str(name)] = env.slots[slot].toJson();
     }
-    if (op == "%")
+    cache->store(stmtHash, stateHash, strings, entry);
+}
+
+// Sum over the set globals among names, so the order they are mentioned in does not matter
+uint64_t Interpreter::hashGlobals(const std::vector<Symbol> &names, const StringTable &strings) const
+{
+    uint64_t h = 0;
+    for (Symbol name : names)
     {
-        ll r = R.toInt();
-        if (r == 0)
-            throw std::runtime_error("Modulo by zero");
-        return Value::makeNum(static_cast<double>(L.toInt() % r));
+        int slot = globalSlotOf[name];
+        if (slot >= 0 && env.slotSet[slot])
+            h += ExecCache::hashGlobal(strings.str(name), env.slots[slot]);
     }
-    if (op == "==")
+    return h;
+}
+
+std::string Interpreter::getOutput(bool pretty) const
+{
+    return env.serialize(pretty);
+}
+
+Value Interpreter::evalExpr(Expr *e)
+{
+    switch (e->kind)
     {
-        if (L.type == R.type)
-        {
-            if (L.type == Value::Type::NUM)
-                return Value::makeBool(L.nval == R.nval);
-            if (L.type == Value::Type::STR)
-                return Value::makeBool(L.sval == R.sval);
-            if (L.type == Value::Type::BOOL)
-                return Value::makeBool(L.bval == R.bval);
-        }
-        return Value::makeBool(false);
+    case NodeKind::LITERAL:
+        return evalLiteral(static_cast<LiteralExpr *>(e));
+    case NodeKind::IDENT:
+        return evalIdent(static_cast<IdentExpr *>(e));
+    case NodeKind::UNARY:
+        return evalUnary(static_cast<UnaryExpr *>(e));
+    case NodeKind::BINARY:
+        return evalBinary(static_cast<BinaryExpr *>(e));
+    case NodeKind::CALL:
+        return evalCall(static_cast<CallExpr *>(e));
+    case NodeKind::ACCESS:
+        return evalAccess(static_cast<AccessExpr *>(e));
+    default:
+        break;
     }
-    if (op == "!=")
+    throw std::runtime_error("Unknown expression node");
+}
+
+Value Interpreter::evalLiteral(LiteralExpr *lit)
+{
+    if (lit->litKind == LiteralExpr::Kind::INTEGER)
+        return Value::makeInt(lit->ival);
+    if (lit->litKind == LiteralExpr::Kind::FLOAT)
+        return Value::makeNum(lit->dval);
+    if (lit->litKind == LiteralExpr::Kind::STRING)
+        return Value::makeStr(env.strings->str(lit->sval));
+    if (lit->litKind == LiteralExpr::Kind::BOOL)
+        return Value::makeBool(lit->bval);
+
+    // 默认返回值，不应该到达这里
+    throw std::runtime_error("Unknown literal kind");
+}
+
+Value Interpreter::evalIdent(IdentExpr *id)
+{
+    // First try to get variable from environment
+    if (Value *var = env.findVar(id->binding))
+        return *var;
+
+    // If in object context, fall back to the field value (or the field name itself)
+    auto field = env.lookupField(id->name);
+    if (field.has_value())
+        return *field;
+
+    throw std::runtime_error("Undefined variable: " + env.strings->str(id->name));
+}
+
+Value Interpreter::evalUnary(UnaryExpr *u)
+{
+    return ops::unary(u->op, evalExpr(u->rhs.get()));
+}
+
+Value Interpreter::evalBinary(BinaryExpr *b)
+{
+    Value L = evalExpr(b->lhs.get());
+
+    // && and || skip the right operand once the left one decides the result
+    if (b->op >= BinaryOp::AND)
     {
-        if (L.type == R.type)
-        {
-            if (L.type == Value::Type::NUM)
-                return Value::makeBool(L.nval != R.nval);
-            if (L.type == Value::Type::STR)
-                return Value::makeBool(L.sval != R.sval);
-            if (L.type == Value::Type::BOOL)
-                return Value::makeBool(L.bval != R.bval);
-        }
-        return Value::makeBool(true);
-    }
-    if (op == "<")
-        return Value::makeBool(L.toNum() < R.toNum());
-    if (op == ">")
-        return Value::makeBool(L.toNum() > R.toNum());
-    if (op == "<=")
-        return Value::makeBool(L.toNum() <= R.toNum());
-    if (op == ">=")
-        return Value::makeBool(L.toNum() >= R.toNum());
-    if (op == "&&")
-        return Value::makeBool(L.toBool() && R.toBool());
-    if (op == "||")
-        return Value::makeBool(L.toBool() || R.toBool());
-
-    throw std::runtime_error("Unknown binary operator: " + op);
+        bool l = L.toBool();
+        if (b->op == BinaryOp::AND ? !l : l)
+            return Value::makeBool(l);
+        return Value::makeBool(evalExpr(b->rhs.get()).toBool());
+    }
+
+    Value R = evalExpr(b->rhs.get());
+    return ops::binary(b->op, L, R);
 }
 
 Value Interpreter::evalCall(CallExpr *c)
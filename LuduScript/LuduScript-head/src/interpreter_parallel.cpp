@@ -0,0 +1,281 @@
+#include "interpreter.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // Counter that every iteration bumps by a constant, e.g. card_id = card_id + 1
+    struct Induction
+    {
+        AssignStmt *assign;
+        int globalSlot;
+        ll delta;
+    };
+
+    // Static independence check for a top-level for loop 并行安全分析
+    // Scope depth 0 is the global scope and 1 the loop scope, which persists across iterations.
+    // Deeper scopes (if branches, obj bodies, init blocks, nested loops) are created fresh by each
+    // iteration, so only writes to depth 0/1 and loop-level break can couple iterations.
+    class LoopAnalysis
+    {
+    public:
+        bool safe = true;
+        std::vector<Induction> inductions;
+
+        explicit LoopAnalysis(ForStmt *fs) : loop(fs)
+        {
+            bool loopContinue = false;
+            for (auto &st : fs->body)
+            {
+                if (matchInduction(st.get()))
+                    continue;
+                stmt(st.get(), 1, false, 0, loopContinue);
+            }
+            // A loop-level continue could skip a counter update
+            if (loopContinue && !inductions.empty())
+                safe = false;
+            for (size_t i = 0; i < inductions.size(); ++i)
+                for (size_t j = 0; j < i; ++j)
+                    if (inductions[i].globalSlot == inductions[j].globalSlot)
+                        safe = false;
+        }
+
+    private:
+        ForStmt *loop;
+
+        bool writesShared(const VarBinding &b) const
+        {
+            for (auto &c : b.candidates)
+                if (c.depth == 0 || (c.depth == 1 && c.index != loop->iterSlot))
+                    return true;
+            return false;
+        }
+
+        // name = name + <int> / name = name - <int>, directly in the loop body, on a global
+        bool matchInduction(Stmt *s)
+        {
+            if (s->kind != NodeKind::ASSIGN)
+                return false;
+            auto as = static_cast<AssignStmt *>(s);
+            if (as->expr->kind != NodeKind::BINARY)
+                return false;
+            auto b = static_cast<BinaryExpr *>(as->expr.get());
+            if ((b->op != BinaryOp::ADD && b->op != BinaryOp::SUB) || b->lhs->kind != NodeKind::IDENT || b->rhs->kind != NodeKind::LITERAL)
+                return false;
+            auto lit = static_cast<LiteralExpr *>(b->rhs.get());
+            if (static_cast<IdentExpr *>(b->lhs.get())->name != as->name || lit->litKind != LiteralExpr::Kind::INTEGER)
+                return false;
+
+            // The loop-scope slot of the name stays unset while the global is set, but the iterator
+            // slot is always set, so i = i + 1 on the iterator never reaches a global i
+            int global = -1;
+            for (auto &c : as->binding.candidates)
+            {
+                if (c.depth == 0)
+                    global = c.index;
+                else if (c.depth != 1 || c.index == loop->iterSlot)
+                    return false;
+            }
+            if (global < 0)
+                return false;
+            inductions.push_back({as, global, b->op == BinaryOp::ADD ? lit->ival : -lit->ival});
+            return true;
+        }
+
+        void body(const std::vector<StmtPtr> &stmts, int depth, bool inObj, int nested, bool &loopContinue)
+        {
+            for (auto &st : stmts)
+                stmt(st.get(), depth, inObj, nested, loopContinue);
+        }
+
+        void stmt(Stmt *s, int depth, bool inObj, int nested, bool &loopContinue)
+        {
+            switch (s->kind)
+            {
+            case NodeKind::ASSIGN:
+            {
+                // Outside an object an unset name is created in the current scope
+                auto as = static_cast<AssignStmt *>(s);
+                if (writesShared(as->binding) || (!inObj && depth <= 1))
+                    safe = false;
+                break;
+            }
+            case NodeKind::DECL:
+            {
+                auto ds = static_cast<DeclStmt *>(s);
+                if (!inObj && depth <= 1)
+                    safe = false;
+                body(ds->initBlock, depth + 1, inObj, nested, loopContinue);
+                break;
+            }
+            case NodeKind::IF:
+            {
+                auto is = static_cast<IfStmt *>(s);
+                body(is->thenBody, depth + 1, inObj, nested, loopContinue);
+                for (auto &elif : is->elifs)
+                    body(elif.second, depth + 1, inObj, nested, loopContinue);
+                body(is->elseBody, depth + 1, inObj, nested, loopContinue);
+                break;
+            }
+            case NodeKind::FOR:
+                body(static_cast<ForStmt *>(s)->body, depth + 1, inObj, nested + 1, loopContinue);
+                break;
+            case NodeKind::OBJ:
+                body(static_cast<ObjStmt *>(s)->body, depth + 1, true, nested, loopContinue);
+                break;
+            case NodeKind::BREAK:
+                if (nested == 0)
+                    safe = false;
+                body(static_cast<BreakStmt *>(s)->body, depth, inObj, nested, loopContinue);
+                break;
+            case NodeKind::CONTINUE:
+                if (nested == 0)
+                    loopContinue = true;
+                body(static_cast<ContinueStmt *>(s)->body, depth, inObj, nested, loopContinue);
+                break;
+            default:
+                break;
+            }
+        }
+    };
+
+    // Iterations [first, last) of the loop, run by one worker
+    struct Chunk
+    {
+        ll first = 0;
+        ll last = 0;
+        ObjectList output;
+        std::exception_ptr error;
+        bool done = false;
+    };
+}
+
+bool Interpreter::execForParallel(ForStmt *fs)
+{
+    LoopAnalysis plan(fs);
+    if (!plan.safe)
+        return false;
+
+    // Counters must be set globals holding integers, so iteration k can start from base + k * delta
+    std::vector<size_t> counterSlots;
+    std::vector<ll> counterBase;
+    for (auto &ind : plan.inductions)
+    {
+        size_t idx = env.frames[0] + ind.globalSlot;
+        if (!env.slotSet[idx] || !env.slots[idx].isInt())
+            return false;
+        counterSlots.push_back(idx);
+        counterBase.push_back(env.slots[idx].intVal());
+    }
+
+    ll start, end, step;
+    evalForRange(fs, start, end, step);
+    ll count = 0;
+    if (step > 0 && start <= end)
+        count = (end - start) / step + 1;
+    else if (step < 0 && start >= end)
+        count = (start - end) / -step + 1;
+    if (count < 2 * static_cast<ll>(jobs))
+    {
+        execForRange(fs, start, end, step);
+        return true;
+    }
+
+    // Several chunks per thread keep the workers busy when iterations differ in cost
+    size_t chunkCount = static_cast<size_t>(std::min<ll>(count, jobs * 8));
+    std::vector<Chunk> chunks(chunkCount);
+    for (size_t c = 0; c < chunkCount; ++c)
+    {
+        chunks[c].first = count * static_cast<ll>(c) / static_cast<ll>(chunkCount);
+        chunks[c].last = count * static_cast<ll>(c + 1) / static_cast<ll>(chunkCount);
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failedChunk{chunkCount};
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    auto work = [&]()
+    {
+        // Private copy of the global scope; the loop never writes it except through the counters
+        Interpreter worker;
+        worker.env.strings = env.strings;
+        worker.env.slots = env.slots;
+        worker.env.slotSet = env.slotSet;
+        worker.env.frames = env.frames;
+        worker.env.pushScope(fs->bodySlots);
+
+        for (size_t c; (c = next++) < chunkCount;)
+        {
+            Chunk &chunk = chunks[c];
+            bool failed = false;
+            if (c < failedChunk.load())
+            {
+                try
+                {
+                    for (size_t i = 0; i < counterSlots.size(); ++i)
+                        worker.env.slots[counterSlots[i]] = Value::makeInt(counterBase[i] + chunk.first * plan.inductions[i].delta);
+                    for (ll k = chunk.first; k < chunk.last; ++k)
+                    {
+                        worker.env.setLocal(fs->iterSlot, Value::makeInt(start + k * step));
+                        worker.execBody(fs->body);
+                    }
+                }
+                catch (...)
+                {
+                    chunk.error = std::current_exception();
+                    failed = true;
+                    size_t prev = failedChunk.load();
+                    while (c < prev && !failedChunk.compare_exchange_weak(prev, c))
+                    {
+                    }
+                }
+                chunk.output = std::move(worker.env.output);
+                worker.env.output.clear();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunk.done = true;
+            }
+            ready.notify_all();
+            // Scopes and objects of the failed iteration are still open; later chunks are not needed
+            if (failed)
+                return;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < jobs; ++t)
+        threads.emplace_back(work);
+
+    // Merge in iteration order; the objects before a failing iteration are kept, as in a sequential run
+    std::exception_ptr error;
+    for (size_t c = 0; c < chunkCount; ++c)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]
+                       { return chunks[c].done; });
+        }
+        env.emit(std::move(chunks[c].output));
+        chunks[c].output = ObjectList();
+        if (chunks[c].error)
+        {
+            error = chunks[c].error;
+            break;
+        }
+    }
+    for (auto &t : threads)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    // Leave the counters where the sequential loop would
+    for (size_t i = 0; i < counterSlots.size(); ++i)
+        env.slots[counterSlots[i]] = Value::makeInt(counterBase[i] + count * plan.inductions[i].delta);
+    return true;
+}
@@ -1,461 +1,369 @@
 #include "interpreter.h"
 #include <stdexcept>
 
-void Interpreter::execStmt(Stmt *s)
+// Kept inline so the unprofiled execStmt is still a single switch
+inline Flow Interpreter::dispatchStmt(Stmt *s)
 {
-    if (auto es = dynamic_cast<ExprStmt *>(s))
+    switch (s->kind)
     {
-        // Evaluate and ignore
-        try
-        {
-            evalExpr(es->expr.get());
-        }
-        catch (const std::exception &ex)
-        {
-            throw std::runtime_error(std::string("Runtime error (line ") + std::to_string(es->line) + "): " + ex.what());
-        }
-        return;
+    case NodeKind::EXPR_STMT:
+        execExprStmt(static_cast<ExprStmt *>(s));
+        return Flow::NORMAL;
+    case NodeKind::ASSIGN:
+        execAssign(static_cast<AssignStmt *>(s));
+        return Flow::NORMAL;
+    case NodeKind::DECL:
+        return execDecl(static_cast<DeclStmt *>(s));
+    case NodeKind::IF:
+        return execIf(static_cast<IfStmt *>(s));
+    case NodeKind::FOR:
+        execFor(static_cast<ForStmt *>(s));
+        return Flow::NORMAL;
+    case NodeKind::OBJ:
+        return execObj(static_cast<ObjStmt *>(s));
+    case NodeKind::BREAK:
+        return execBreak(static_cast<BreakStmt *>(s));
+    case NodeKind::CONTINUE:
+        return execContinue(static_cast<ContinueStmt *>(s));
+    default:
+        break;
     }
+    throw std::runtime_error("Unknown statement node");
+}
 
-    if (auto as = dynamic_cast<AssignStmt *>(s))
+Flow Interpreter::execStmt(Stmt *s)
+{
+#if defined(LUDUSCRIPT_PROFILER)
+    if (profiler)
+        return execStmtProfiled(s);
+#endif
+    return dispatchStmt(s);
+}
+
+Flow Interpreter::execStmtProfiled(Stmt *s)
+{
+    // Leave the statement on every path out, runtime errors included
+    struct Leave
     {
-        Value v = evalExpr(as->expr.get());
+        Profiler *p;
+        ~Leave() { p->exit(); }
+    };
+    profiler->enter(s);
+    Leave leave{profiler};
+    return dispatchStmt(s);
+}
 
-        // Check if variable exists in any outer scope first
-        bool found = false;
-        for (int i = int(env.stack.size()) - 1; i >= 0; --i)
-        {
-            auto it = env.stack[i].find(as->name);
-            if (it != env.stack[i].end())
-            {
-                // Update existing variable in its original scope
-                env.stack[i][as->name] = v;
-                found = true;
-                break;
-            }
-        }
+bool Interpreter::setProfiler(Profiler *p)
+{
+#if defined(LUDUSCRIPT_PROFILER)
+    profiler = p;
+    return true;
+#else
+    (void)p;
+    return false;
+#endif
+}
 
-        if (!found)
-        {
-            // Variable doesn't exist in stack, check if inside object
-            if (env.current_object.has_value())
-            {
-                // Check if it's already declared as object field
-                if (env.declared_fields.count(as->name) > 0 || env.current_object->contains(as->name))
-                {
-                    // Update existing object field
-                    if (v.type == Value::Type::NUM && v.isInteger)
-                        env.current_object->operator[](as->name) = json(static_cast<ll>(v.nval));
-                    else if (v.type == Value::Type::NUM)
-                        env.current_object->operator[](as->name) = json(v.nval);
-                    else if (v.type == Value::Type::BOOL)
-                        env.current_object->operator[](as->name) = json(v.bval);
-                    else
-                        env.current_object->operator[](as->name) = json(v.sval);
-                }
-                else
-                {
-                    // Create new object field
-                    if (v.type == Value::Type::NUM && v.isInteger)
-                        env.current_object->operator[](as->name) = json(static_cast<ll>(v.nval));
-                    else if (v.type == Value::Type::NUM)
-                        env.current_object->operator[](as->name) = json(v.nval);
-                    else if (v.type == Value::Type::BOOL)
-                        env.current_object->operator[](as->name) = json(v.bval);
-                    else
-                        env.current_object->operator[](as->name) = json(v.sval);
-                    env.declared_fields.insert(as->name);
-                }
-            }
-            else
-            {
-                // Create in current scope
-                env.setVar(as->name, v);
-            }
-        }
-        return;
+void Interpreter::execExprStmt(ExprStmt *es)
+{
+    // Evaluate and ignore
+    try
+    {
+        evalExpr(es->expr.get());
     }
-
-    if (auto ds = dynamic_cast<DeclStmt *>(s))
+    catch (const std::exception &ex)
     {
-        Value v;
-        if (!ds->initBlock.empty())
-        {
-            // Create new scope for the initialization block
-            env.pushScope();
+        throw std::runtime_error(std::string("Runtime error (line ") + std::to_string(es->line) + "): " + ex.what());
+    }
+}
 
-            // Keep object context active so fields can be accessed in initialization blocks
-            // This is required by SYNTAX.md specification
+void Interpreter::execAssign(AssignStmt *as)
+{
+    Value v = evalExpr(as->expr.get());
 
-            // Execute statements in the block and track the last expression value
-            Value lastExprValue;
-            bool hasLastExpr = false;
-            std::string lastVar;
+    // Update the variable if it is already set in any enclosing scope
+    if (Value *var = env.findVar(as->binding))
+    {
+        *var = std::move(v);
+        return;
+    }
 
-            for (size_t i = 0; i < ds->initBlock.size(); ++i)
-            {
-                auto &stmt = ds->initBlock[i];
-                bool isLastStmt = (i == ds->initBlock.size() - 1);
-
-                // Check if this is an expression statement (the last expression should be returned)
-                if (auto exprStmt = dynamic_cast<ExprStmt *>(stmt.get()))
-                {
-                    lastExprValue = evalExpr(exprStmt->expr.get());
-                    hasLastExpr = true;
-                }
-                // Special handling for if statements that can return values
-                else if (isLastStmt)
-                {
-                    if (auto ifStmt = dynamic_cast<IfStmt *>(stmt.get()))
-                    {
-                        // For if statements as the last statement, we need to capture their return value
-                        lastExprValue = execIfWithReturn(ifStmt);
-                        hasLastExpr = true;
-                    }
-                    else
-                    {
-                        execStmt(stmt.get());
-                        // If it's a declaration, track it as potential last variable
-                        if (auto innerDecl = dynamic_cast<DeclStmt *>(stmt.get()))
-                        {
-                            lastVar = innerDecl->name;
-                        }
-                    }
-                }
-                else
-                {
-                    execStmt(stmt.get());
-                    // If it's a declaration, track it as potential last variable
-                    if (auto innerDecl = dynamic_cast<DeclStmt *>(stmt.get()))
-                    {
-                        lastVar = innerDecl->name;
-                    }
-                }
-            }
+    // Variable doesn't exist in stack: inside an object it becomes a field
+    if (env.inObject())
+        env.assignField(as->name, v);
+    else
+        env.setLocal(as->binding.own, std::move(v)); // Create in current scope
+}
+
+Flow Interpreter::execDecl(DeclStmt *ds)
+{
+    Value v;
+    if (!ds->initBlock.empty())
+    {
+        // Create new scope for the initialization block
+        env.pushScope(ds->initSlots);
 
-            // Get the final value: prefer last expression, then last declared variable
-            Value blockResult;
-            bool hasResult = false;
+        // Keep object context active so fields can be accessed in initialization blocks
+        // This is required by SYNTAX.md specification
 
-            if (hasLastExpr)
-            {
-                blockResult = lastExprValue;
-                hasResult = true;
-            }
-            else if (!lastVar.empty())
-            {
-                auto varValue = env.getVar(lastVar);
-                if (varValue.has_value())
-                {
-                    blockResult = varValue.value();
-                    hasResult = true;
-                }
-            }
+        // Execute statements in the block and track the last expression value
+        Value lastExprValue;
+        bool hasLastExpr = false;
 
-            // Pop the scope
-            env.popScope();
+        for (size_t i = 0; i < ds->initBlock.size(); ++i)
+        {
+            auto &stmt = ds->initBlock[i];
+            bool isLastStmt = (i == ds->initBlock.size() - 1);
 
-            // Set the final value
-            if (hasResult)
+            Flow flow = Flow::NORMAL;
+            // Check if this is an expression statement (the last expression should be returned)
+            if (stmt->kind == NodeKind::EXPR_STMT)
             {
-                v = blockResult;
+                lastExprValue = evalExpr(static_cast<ExprStmt *>(stmt.get())->expr.get());
+                hasLastExpr = true;
             }
-            else
+            // Special handling for if statements that can return values
+            else if (isLastStmt && stmt->kind == NodeKind::IF)
             {
-                // No valid result, use default
-                if (ds->type == "num")
-                    v = Value::makeNum(0.0);
-                else if (ds->type == "str")
-                    v = Value::makeStr("");
-                else if (ds->type == "bool")
-                    v = Value::makeBool(false);
+                // For if statements as the last statement, we need to capture their return value
+                flow = execIfWithReturn(static_cast<IfStmt *>(stmt.get()), lastExprValue);
+                hasLastExpr = true;
             }
-        }
-        else if (ds->init.has_value())
-        {
-            v = evalExpr(ds->init->get());
-        }
-        else
-        {
-            // Default values
-            if (ds->type == "num")
-                v = Value::makeNum(0.0);
-            else if (ds->type == "str")
-                v = Value::makeStr("");
-            else if (ds->type == "bool")
-                v = Value::makeBool(false);
-        }
-
-        // If inside object, write to object field, else to var
-        if (env.current_object.has_value())
-        {
-            if (v.type == Value::Type::NUM && v.isInteger)
-                env.current_object->operator[](ds->name) = json(static_cast<ll>(v.nval));
-            else if (v.type == Value::Type::NUM)
-                env.current_object->operator[](ds->name) = json(v.nval);
-            else if (v.type == Value::Type::BOOL)
-                env.current_object->operator[](ds->name) = json(v.bval);
             else
-                env.current_object->operator[](ds->name) = json(v.sval);
-            env.declared_fields.insert(ds->name);
-        }
-        else
-        {
-            env.setVar(ds->name, v);
-        }
-        return;
-    }
-
-    if (auto is = dynamic_cast<IfStmt *>(s))
-    {
-        Value cond = evalExpr(is->cond.get());
-        if (cond.toBool())
-        {
-            execBlock(is->thenBody);
-        }
-        else
-        {
-            // Check elif conditions
-            bool executed = false;
-            for (auto &elif : is->elifs)
             {
-                Value elifCond = evalExpr(elif.first.get());
-                if (elifCond.toBool())
-                {
-                    execBlock(elif.second);
-                    executed = true;
-                    break;
-                }
+                flow = execStmt(stmt.get());
             }
 
-            // Execute else block if no elif was executed
-            if (!executed && !is->elseBody.empty())
+            // break/continue leaves the declaration unassigned
+            if (flow != Flow::NORMAL)
             {
-                execBlock(is->elseBody);
+                env.popScope();
+                return flow;
             }
         }
-        return;
-    }
 
-    if (auto fs = dynamic_cast<ForStmt *>(s))
-    {
-        ll start = 1, end = 1, step = 1;
+        // Get the final value: prefer last expression, then last declared variable
+        Value blockResult;
+        bool hasResult = false;
 
-        if (fs->args.size() == 1)
+        if (hasLastExpr)
         {
-            // for(i, N) -> i from 1 to N
-            end = evalExpr(fs->args[0].get()).toInt();
+            blockResult = lastExprValue;
+            hasResult = true;
         }
-        else if (fs->args.size() == 2)
+        else if (Value *lastVar = env.findVar(ds->result))
         {
-            // for(i, start, end) -> i from start to end
-            start = evalExpr(fs->args[0].get()).toInt();
-            end = evalExpr(fs->args[1].get()).toInt();
+            // The resolver bound ds->result to the last variable declared in the block
+            blockResult = *lastVar;
+            hasResult = true;
         }
-        else if (fs->args.size() == 3)
-        {
-            // for(i, start, end, step)
-            start = evalExpr(fs->args[0].get()).toInt();
-            end = evalExpr(fs->args[1].get()).toInt();
-            step = evalExpr(fs->args[2].get()).toInt();
-        }
-
-        // Iterate
-        env.pushScope();
-        if (step == 0)
-            step = 1;
 
-        if (step > 0)
-        {
-            for (ll it = start; it <= end; it += step)
-            {
-                env.setVar(fs->iter, Value::makeInt(it));
-                try
-                {
-                    // Execute statements directly without creating additional scope
-                    for (auto &st : fs->body)
-                        execStmt(st.get());
-                }
-                catch (const BreakException &)
-                {
-                    break;
-                }
-                catch (const ContinueException &)
-                {
-                    continue;
-                }
-                catch (...)
-                {
-                    env.popScope();
-                    throw;
-                }
-            }
-        }
-        else
-        {
-            for (ll it = start; it >= end; it += step)
-            {
-                env.setVar(fs->iter, Value::makeInt(it));
-                try
-                {
-                    // Execute statements directly without creating additional scope
-                    for (auto &st : fs->body)
-                        execStmt(st.get());
-                }
-                catch (const BreakException &)
-                {
-                    break;
-                }
-                catch (const ContinueException &)
-                {
-                    continue;
-                }
-                catch (...)
-                {
-                    env.popScope();
-                    throw;
-                }
-            }
-        }
+        // Pop the scope
         env.popScope();
-        return;
-    }
 
-    if (auto os = dynamic_cast<ObjStmt *>(s))
+        // Set the final value, or the default if there is no valid result
+        v = hasResult ? blockResult : Value::makeDefault(ds->type);
+    }
+    else if (ds->init.has_value())
     {
-        // Create object
-        env.current_object = json::object();
-        env.declared_fields.clear();
-        env.current_object->operator[]("class") = os->className;
-
-        Value idv = evalExpr(os->idExpr.get());
-        // ID as int if int, num if num, else string
-        if (idv.type == Value::Type::NUM)
-        {
-            if (idv.isInteger)
-            {
-                env.current_object->operator[]("id") = static_cast<ll>(idv.nval);
-            }
-            else
-            {
-                env.current_object->operator[]("id") = idv.nval;
-            }
-        }
-        else
-        {
-            env.current_object->operator[]("id") = idv.toStr();
-        }
+        v = evalExpr(ds->init->get());
+    }
+    else
+    {
+        // Default values
+        v = Value::makeDefault(ds->type);
+    }
 
-        // Execute body with object context; use new scope for body variables
-        env.pushScope();
-        for (auto &st : os->body)
-        {
-            execStmt(st.get());
-        }
-        env.popScope();
+    // If inside object, write to object field, else to var
+    if (env.inObject())
+        env.declareField(ds->name, v);
+    else
+        env.setLocal(ds->slot, std::move(v));
+    return Flow::NORMAL;
+}
 
-        // Push to output
-        env.output.push_back(*env.current_object);
-        env.current_object.reset();
-        env.declared_fields.clear();
-        return;
+Flow Interpreter::execIf(IfStmt *is)
+{
+    Value cond = evalExpr(is->cond.get());
+    if (cond.toBool())
+        return execBlock(is->thenBody, is->thenSlots);
+
+    // Check elif conditions
+    for (size_t i = 0; i < is->elifs.size(); ++i)
+    {
+        auto &elif = is->elifs[i];
+        Value elifCond = evalExpr(elif.first.get());
+        if (elifCond.toBool())
+            return execBlock(elif.second, is->elifSlots[i]);
     }
 
-    if (auto bs = dynamic_cast<BreakStmt *>(s))
+    // Execute else block if no elif was executed
+    if (!is->elseBody.empty())
+        return execBlock(is->elseBody, is->elseSlots);
+    return Flow::NORMAL;
+}
+
+void Interpreter::evalForRange(ForStmt *fs, ll &start, ll &end, ll &step)
+{
+    start = 1, end = 1, step = 1;
+
+    if (fs->args.size() == 1)
     {
-        // 执行break语句块中的语句
-        for (const auto &stmt : bs->body)
-        {
-            execStmt(stmt.get());
-        }
-        throw BreakException();
+        // for(i, N) -> i from 1 to N
+        end = evalExpr(fs->args[0].get()).toInt();
     }
+    else if (fs->args.size() == 2)
+    {
+        // for(i, start, end) -> i from start to end
+        start = evalExpr(fs->args[0].get()).toInt();
+        end = evalExpr(fs->args[1].get()).toInt();
+    }
+    else if (fs->args.size() == 3)
+    {
+        // for(i, start, end, step)
+        start = evalExpr(fs->args[0].get()).toInt();
+        end = evalExpr(fs->args[1].get()).toInt();
+        step = evalExpr(fs->args[2].get()).toInt();
+    }
+    if (step == 0)
+        step = 1;
+}
+
+void Interpreter::execFor(ForStmt *fs)
+{
+    ll start, end, step;
+    evalForRange(fs, start, end, step);
+    execForRange(fs, start, end, step);
+}
+
+void Interpreter::execForRange(ForStmt *fs, ll start, ll end, ll step)
+{
+    // Iterate
+    env.pushScope(fs->bodySlots);
 
-    if (auto cs = dynamic_cast<ContinueStmt *>(s))
+    try
     {
-        // 执行continue语句块中的语句
-        for (const auto &stmt : cs->body)
+        for (ll it = start; step > 0 ? it <= end : it >= end; it += step)
         {
-            execStmt(stmt.get());
+            env.setLocal(fs->iterSlot, Value::makeInt(it));
+            // Execute statements directly without creating additional scope;
+            // nested blocks have already closed their scopes and objects when a signal gets here
+            if (execBody(fs->body) == Flow::BREAK)
+                break;
         }
-        throw ContinueException();
     }
+    catch (...)
+    {
+        env.popScope();
+        throw;
+    }
+    env.popScope();
+}
 
-    throw std::runtime_error("Unknown statement node");
+Flow Interpreter::execObj(ObjStmt *os)
+{
+    // Create object
+    env.beginObject(os->className);
+    env.setObjectId(evalExpr(os->idExpr.get()));
+
+    // Execute body with object context; use new scope for body variables
+    env.pushScope(os->bodySlots);
+    Flow flow = execBody(os->body);
+    env.popScope();
+
+    // Push to output; an object left by break/continue is dropped
+    if (flow == Flow::NORMAL)
+        env.endObject();
+    else
+        env.abortObject();
+    return flow;
+}
+
+Flow Interpreter::execBreak(BreakStmt *bs)
+{
+    // 执行break语句块中的语句
+    Flow flow = execBody(bs->body);
+    return flow == Flow::NORMAL ? Flow::BREAK : flow;
+}
+
+Flow Interpreter::execContinue(ContinueStmt *cs)
+{
+    // 执行continue语句块中的语句
+    Flow flow = execBody(cs->body);
+    return flow == Flow::NORMAL ? Flow::CONTINUE : flow;
 }
 
 // Helper function to execute if statement and return its value
-Value Interpreter::execIfWithReturn(IfStmt *is)
+Flow Interpreter::execIfWithReturn(IfStmt *is, Value &result)
 {
     Value cond = evalExpr(is->cond.get());
     if (cond.toBool())
+        return execBlockWithReturn(is->thenBody, is->thenSlots, result);
+
+    // Check elif conditions
+    for (size_t i = 0; i < is->elifs.size(); ++i)
     {
-        return execBlockWithReturn(is->thenBody);
+        auto &elif = is->elifs[i];
+        Value elifCond = evalExpr(elif.first.get());
+        if (elifCond.toBool())
+            return execBlockWithReturn(elif.second, is->elifSlots[i], result);
     }
-    else
-    {
-        // Check elif conditions
-        for (auto &elif : is->elifs)
-        {
-            Value elifCond = evalExpr(elif.first.get());
-            if (elifCond.toBool())
-            {
-                return execBlockWithReturn(elif.second);
-            }
-        }
 
-        // Execute else block if available
-        if (!is->elseBody.empty())
-        {
-            return execBlockWithReturn(is->elseBody);
-        }
-    }
+    // Execute else block if available
+    if (!is->elseBody.empty())
+        return execBlockWithReturn(is->elseBody, is->elseSlots, result);
 
     // No matching condition, return default value
-    return Value::makeNum(0.0);
+    result = Value::makeNum(0.0);
+    return Flow::NORMAL;
 }
 
 // Helper function to execute block and return the last expression value
-Value Interpreter::execBlockWithReturn(const std::vector<StmtPtr> &body)
+Flow Interpreter::execBlockWithReturn(const std::vector<StmtPtr> &body, int slots, Value &result)
 {
-    env.pushScope();
-
-    Value lastValue = Value::makeNum(0.0);
-    bool hasValue = false;
+    env.pushScope(slots);
 
+    result = Value::makeNum(0.0);
     for (size_t i = 0; i < body.size(); ++i)
     {
         auto &stmt = body[i];
         bool isLastStmt = (i == body.size() - 1);
 
-        if (isLastStmt)
+        if (isLastStmt && stmt->kind == NodeKind::EXPR_STMT)
         {
-            if (auto exprStmt = dynamic_cast<ExprStmt *>(stmt.get()))
-            {
-                // Last statement is an expression, return its value
-                lastValue = evalExpr(exprStmt->expr.get());
-                hasValue = true;
-            }
-            else
-            {
-                execStmt(stmt.get());
-            }
+            // Last statement is an expression, return its value
+            result = evalExpr(static_cast<ExprStmt *>(stmt.get())->expr.get());
         }
         else
         {
-            execStmt(stmt.get());
+            Flow flow = execStmt(stmt.get());
+            if (flow != Flow::NORMAL)
+            {
+                env.popScope();
+                return flow;
+            }
         }
     }
 
     env.popScope();
-
-    return hasValue ? lastValue : Value::makeNum(0.0);
+    return Flow::NORMAL;
 }
 
-void Interpreter::execBlock(const std::vector<StmtPtr> &body)
+Flow Interpreter::execBody(const std::vector<StmtPtr> &body)
 {
-    env.pushScope();
     for (auto &st : body)
-        execStmt(st.get());
+    {
+        Flow flow = execStmt(st.get());
+        if (flow != Flow::NORMAL)
+            return flow;
+    }
+    return Flow::NORMAL;
+}
+
+Flow Interpreter::execBlock(const std::vector<StmtPtr> &body, int slots)
+{
+    env.pushScope(slots);
+    Flow flow = execBody(body);
     env.popScope();
-}
\ No newline at end of file
+    return flow;
+}
@@ -0,0 +1,252 @@
+#include "json_writer.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    // Length of the well-formed UTF-8 sequence starting at p (a lead byte >= 0x80), 0 if invalid.
+    // Accepts exactly what json::dump() accepts: no overlong forms, surrogates or code points past U+10FFFF
+    size_t utf8Length(const unsigned char *p, const unsigned char *end)
+    {
+        unsigned char c = p[0];
+        unsigned char lo = 0x80, hi = 0xBF; // allowed range of the second byte
+        size_t n;
+        if (c >= 0xC2 && c <= 0xDF)
+            n = 2;
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 3;
+            if (c == 0xE0)
+                lo = 0xA0;
+            else if (c == 0xED)
+                hi = 0x9F;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 4;
+            if (c == 0xF0)
+                lo = 0x90;
+            else if (c == 0xF4)
+                hi = 0x8F;
+        }
+        else
+            return 0;
+
+        if (static_cast<size_t>(end - p) < n || p[1] < lo || p[1] > hi)
+            return 0;
+        for (size_t i = 2; i < n; ++i)
+            if ((p[i] & 0xC0) != 0x80)
+                return 0;
+        return n;
+    }
+}
+
+JsonWriter::JsonWriter(const StringTable &s, bool p, FieldOrder o) : strings(s), pretty(p), fieldOrder(o)
+{
+}
+
+bool JsonWriter::isUtf8(std::string_view s)
+{
+    auto p = reinterpret_cast<const unsigned char *>(s.data());
+    auto end = p + s.size();
+    while (p < end)
+    {
+        if (*p < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        size_t n = utf8Length(p, end);
+        if (n == 0)
+            return false;
+        p += n;
+    }
+    return true;
+}
+
+void JsonWriter::writeString(std::string &out, std::string_view s)
+{
+    size_t quote = out.size();
+    out += '"';
+    auto p = reinterpret_cast<const unsigned char *>(s.data());
+    auto end = p + s.size();
+    auto run = p; // start of the bytes not copied yet
+    while (p < end)
+    {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        if (c >= 0x80)
+        {
+            // Multi-byte characters (the Chinese card text) are copied through unchanged
+            size_t n = utf8Length(p, end);
+            if (n == 0)
+            {
+                // Let nlohmann report the invalid byte, so the error reads exactly as before
+                out.resize(quote);
+                out += json(std::string(s)).dump();
+                return;
+            }
+            p += n;
+            continue;
+        }
+
+        out.append(reinterpret_cast<const char *>(run), reinterpret_cast<const char *>(p));
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+        {
+            static const char hex[] = "0123456789abcdef";
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out.append(esc, sizeof(esc));
+            break;
+        }
+        }
+        run = ++p;
+    }
+    out.append(reinterpret_cast<const char *>(run), reinterpret_cast<const char *>(p));
+    out += '"';
+}
+
+void JsonWriter::writeValue(std::string &out, const Value &v)
+{
+    char buf[64];
+    if (v.isInt())
+    {
+        auto res = std::to_chars(buf, buf + sizeof(buf), v.intVal());
+        out.append(buf, res.ptr);
+    }
+    else if (v.isFloat())
+    {
+        // nlohmann's Grisu2 formatting ("1.0", "4.5", "1e+20"), which std::to_chars does not reproduce
+        double d = v.numVal();
+        if (!std::isfinite(d))
+            out += "null";
+        else
+            out.append(buf, nlohmann::detail::to_chars(buf, buf + sizeof(buf), d));
+    }
+    else if (v.isStr())
+        writeString(out, v.strVal());
+    else
+        out += v.boolVal() ? "true" : "false";
+}
+
+void JsonWriter::buildLayout(Layout &layout, ObjectView obj) const
+{
+    size_t n = obj.size();
+    layout.keys.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        layout.keys[i] = obj[i].key;
+
+    // Sorted output uses byte-wise key order, the order of json's std::map
+    layout.order.resize(n);
+    std::iota(layout.order.begin(), layout.order.end(), 0u);
+    if (fieldOrder == FieldOrder::SORTED)
+        std::sort(layout.order.begin(), layout.order.end(), [&](uint32_t a, uint32_t b)
+                  { return strings.str(layout.keys[a]) < strings.str(layout.keys[b]); });
+
+    layout.prefixes.resize(n);
+    for (size_t j = 0; j < n; ++j)
+    {
+        std::string &prefix = layout.prefixes[j];
+        prefix.clear();
+        if (pretty)
+            prefix += j == 0 ? "{\n    " : ",\n    ";
+        else
+            prefix += j == 0 ? '{' : ',';
+        writeString(prefix, strings.str(layout.keys[layout.order[j]]));
+        prefix += pretty ? ": " : ":";
+    }
+}
+
+const JsonWriter::Layout &JsonWriter::layoutFor(ObjectView obj)
+{
+    auto matches = [&](const Layout &layout)
+    {
+        if (layout.keys.size() != obj.size())
+            return false;
+        for (size_t i = 0; i < layout.keys.size(); ++i)
+            if (layout.keys[i] != obj[i].key)
+                return false;
+        return true;
+    };
+
+    if (last < layouts.size() && matches(layouts[last]))
+        return layouts[last];
+    for (size_t i = 0; i < layouts.size(); ++i)
+    {
+        if (matches(layouts[i]))
+        {
+            last = i;
+            return layouts[i];
+        }
+    }
+    if (layouts.size() < kMaxLayouts)
+    {
+        layouts.emplace_back();
+        buildLayout(layouts.back(), obj);
+        last = layouts.size() - 1;
+        return layouts.back();
+    }
+    buildLayout(scratch, obj);
+    return scratch;
+}
+
+void JsonWriter::writeObject(std::string &out, ObjectView obj)
+{
+    if (obj.empty())
+    {
+        out += "{}";
+        return;
+    }
+    const Layout &layout = layoutFor(obj);
+    for (size_t j = 0; j < layout.order.size(); ++j)
+    {
+        out += layout.prefixes[j];
+        writeValue(out, obj[layout.order[j]].value);
+    }
+    out += pretty ? "\n  }" : "}";
+}
+
+void JsonWriter::writeArray(std::string &out, const ObjectList &objects)
+{
+    if (objects.empty())
+    {
+        out += "[]";
+        return;
+    }
+    out += pretty ? "[\n  " : "[";
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        if (i > 0)
+            out += pretty ? ",\n  " : ",";
+        writeObject(out, objects[i]);
+    }
+    out += pretty ? "\n]" : "]";
+}
@@ -1,9 +1,201 @@
 #include "lexer.h"
 #include <cctype>
+#include <cstdint>
 
-Token::Token(TokenKind k, std::string t, int l) : kind(k), text(std::move(t)), line(l) {}
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LUDUS_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LUDUS_SIMD_SSE2 1
+#endif
 
-Lexer::Lexer(std::string s) : src(std::move(s)) {}
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bulk byte-class scanning 批量字符扫描
+// Generated scripts are mostly indentation, comments and identifiers, so those runs are
+// classified a whole vector at a time (AVX2: 32 bytes, SSE2: 16 bytes). Each helper returns
+// the first position at or after i whose byte leaves the class; the last partial vector and
+// builds without SIMD use the scalar loop. All classes are ASCII-only, like <cctype> in the
+// default "C" locale, so bytes >= 0x80 never match.
+namespace
+{
+    inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+    inline bool isIdentChar(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+    inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    inline unsigned countTrailingZeros(uint32_t m)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, m);
+        return static_cast<unsigned>(idx);
+#else
+        return static_cast<unsigned>(__builtin_ctz(m));
+#endif
+    }
+
+    inline int popCount(uint32_t m)
+    {
+#if defined(_MSC_VER)
+        m = m - ((m >> 1) & 0x55555555u);
+        m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+        return static_cast<int>((((m + (m >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#else
+        return __builtin_popcount(m);
+#endif
+    }
+
+#if defined(LUDUS_SIMD_AVX2)
+    constexpr size_t kWidth = 32;
+    using Vec = __m256i;
+    inline Vec load(const char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    inline Vec splat(char c) { return _mm256_set1_epi8(c); }
+    inline Vec eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+    inline Vec gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+    inline Vec bitOr(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+    inline Vec bitAnd(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+    inline uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+    constexpr uint32_t kAll = 0xFFFFFFFFu;
+#elif defined(LUDUS_SIMD_SSE2)
+    constexpr size_t kWidth = 16;
+    using Vec = __m128i;
+    inline Vec load(const char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    inline Vec splat(char c) { return _mm_set1_epi8(c); }
+    inline Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+    inline Vec gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+    inline Vec bitOr(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    inline Vec bitAnd(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    inline uint32_t mask(Vec v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+    constexpr uint32_t kAll = 0xFFFFu;
+#endif
+
+#if defined(LUDUS_SIMD_AVX2) || defined(LUDUS_SIMD_SSE2)
+#define LUDUS_SIMD 1
+    // lo <= c <= hi as a signed byte compare; every bound is ASCII, so bytes >= 0x80 (negative) fail
+    inline Vec inRange(Vec v, char lo, char hi) { return bitAnd(gt(v, splat(static_cast<char>(lo - 1))), gt(splat(static_cast<char>(hi + 1)), v)); }
+
+    inline uint32_t blankMask(Vec v) { return mask(bitOr(bitOr(eq(v, splat(' ')), eq(v, splat('\t'))), bitOr(eq(v, splat('\r')), eq(v, splat('\n'))))); }
+    inline uint32_t digitMask(Vec v) { return mask(inRange(v, '0', '9')); }
+    inline uint32_t identMask(Vec v)
+    {
+        Vec letter = inRange(bitOr(v, splat(0x20)), 'a', 'z');
+        return mask(bitOr(bitOr(letter, inRange(v, '0', '9')), eq(v, splat('_'))));
+    }
+#endif
+
+    // Whitespace run; line is advanced by the newlines skipped
+    size_t skipBlanks(std::string_view s, size_t i, int &line)
+    {
+#if defined(LUDUS_SIMD)
+        while (i + kWidth <= s.size())
+        {
+            Vec v = load(s.data() + i);
+            uint32_t blank = blankMask(v);
+            uint32_t newlines = mask(eq(v, splat('\n')));
+            if (blank != kAll)
+            {
+                unsigned n = countTrailingZeros(~blank & kAll);
+                line += popCount(newlines & ((1u << n) - 1u));
+                return i + n;
+            }
+            line += popCount(newlines);
+            i += kWidth;
+        }
+#endif
+        for (; i < s.size() && isBlank(s[i]); ++i)
+        {
+            if (s[i] == '\n')
+                line++;
+        }
+        return i;
+    }
+
+    // Comment body: up to the newline, or a NUL byte, which the lexer treats as the end
+    size_t skipToLineEnd(std::string_view s, size_t i)
+    {
+#if defined(LUDUS_SIMD)
+        while (i + kWidth <= s.size())
+        {
+            Vec v = load(s.data() + i);
+            uint32_t stop = mask(bitOr(eq(v, splat('\n')), eq(v, splat('\0'))));
+            if (stop)
+                return i + countTrailingZeros(stop);
+            i += kWidth;
+        }
+#endif
+        while (i < s.size() && s[i] != '\n' && s[i] != '\0')
+            ++i;
+        return i;
+    }
+
+    size_t scanIdent(std::string_view s, size_t i)
+    {
+#if defined(LUDUS_SIMD)
+        while (i + kWidth <= s.size())
+        {
+            uint32_t outside = ~identMask(load(s.data() + i)) & kAll;
+            if (outside)
+                return i + countTrailingZeros(outside);
+            i += kWidth;
+        }
+#endif
+        while (i < s.size() && isIdentChar(s[i]))
+            ++i;
+        return i;
+    }
+
+    size_t scanDigits(std::string_view s, size_t i)
+    {
+#if defined(LUDUS_SIMD)
+        while (i + kWidth <= s.size())
+        {
+            uint32_t outside = ~digitMask(load(s.data() + i)) & kAll;
+            if (outside)
+                return i + countTrailingZeros(outside);
+            i += kWidth;
+        }
+#endif
+        while (i < s.size() && isDigit(s[i]))
+            ++i;
+        return i;
+    }
+}
+
+Token::Token(TokenKind k, std::string_view t, int l, bool esc) : kind(k), text(t), line(l), escaped(esc) {}
+
+std::string Token::str() const
+{
+    return escaped ? Lexer::unescape(text) : std::string(text);
+}
+
+Lexer::Lexer(std::string_view s) : src(s) {}
+
+std::string Lexer::unescape(std::string_view raw)
+{
+    std::string s;
+    s.reserve(raw.size());
+    for (size_t k = 0; k < raw.size(); ++k)
+    {
+        char ch = raw[k];
+        if (ch != '\\')
+        {
+            s.push_back(ch);
+            continue;
+        }
+        // A trailing backslash only occurs in an unterminated literal, which read past the end
+        char nx = ++k < raw.size() ? raw[k] : '\0';
+        if (nx == 'n')
+            s.push_back('\n');
+        else if (nx == 't')
+            s.push_back('\t');
+        else
+            s.push_back(nx);
+    }
+    return s;
+}
 
 char Lexer::peek() const
 {
@@ -23,21 +215,11 @@ void Lexer::skipWhitespace()
 {
     while (true)
     {
-        char c = peek();
-        if (c == ' ' || c == '\t' || c == '\r')
-        {
-            get();
-        }
-        else if (c == '\n')
-        {
-            get();
-            line++;
-        }
-        else if (c == '/' && i + 1 < src.size() && src[i + 1] == '/')
+        i = skipBlanks(src, i, line);
+        if (i + 1 < src.size() && src[i] == '/' && src[i + 1] == '/')
         {
-            // 跳过注释
-            while (peek() != '\n' && peek() != '\0')
-                get();
+            // 跳过注释, 换行符留给下一轮计数
+            i = skipToLineEnd(src, i + 2);
         }
         else
         {
@@ -171,11 +353,11 @@ Token Lexer::nextToken()
     }
 
     // 标识符或保留字
-    if (std::isalpha(c) || c == '_')
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
     {
-        std::string s;
-        while (std::isalnum(peek()) || peek() == '_')
-            s.push_back(get());
+        size_t begin = i;
+        i = scanIdent(src, i + 1);
+        std::string_view s = src.substr(begin, i - begin);
 
         // 检查保留字
         if (s == "if")
@@ -207,32 +389,18 @@ Token Lexer::nextToken()
     }
 
     // Numbers
-    if (std::isdigit(c))
+    if (std::isdigit(static_cast<unsigned char>(c)))
     {
-        std::string s;
-        while (std::isdigit(peek()))
-            s.push_back(get());
+        size_t begin = i;
+        i = scanDigits(src, i + 1);
 
         // 检查是否有小数点
-        if (peek() == '.')
+        if (peek() == '.' && i + 1 < src.size() && isDigit(src[i + 1]))
         {
-            // 先预览小数点后是否有数字
-            size_t saved_pos = i;
-            get(); // 消费小数点
-
-            if (std::isdigit(peek()))
-            {
-                // 有效的小数, 添加小数点和小数部分
-                s.push_back('.');
-                while (std::isdigit(peek()))
-                    s.push_back(get());
-            }
-            else
-            {
-                // 小数点后没有数字, 回退
-                i = saved_pos;
-            }
+            // 有效的小数, 包含小数点和小数部分; 小数点后没有数字时不消费小数点
+            i = scanDigits(src, i + 1);
         }
+        std::string_view s = src.substr(begin, i - begin);
 
         return Token(TokenKind::NUMBER, s, line);
     }
@@ -241,37 +409,39 @@ Token Lexer::nextToken()
     if (c == '"')
     {
         get(); // 消费 "
-        std::string s;
+        size_t begin = i;
+        bool escaped = false;
         while (true)
         {
             char ch = get();
             if (ch == '\0')
-                return Token(TokenKind::UNKNOWN, s, line);
+                return Token(TokenKind::UNKNOWN, src.substr(begin, i - begin - (i > begin && src[i - 1] == '\0')), line, escaped);
             if (ch == '"')
                 break;
             if (ch == '\\')
             {
-                char nx = get();
-                if (nx == 'n')
-                    s.push_back('\n');
-                else if (nx == 't')
-                    s.push_back('\t');
-                else if (nx == '"')
-                    s.push_back('"');
-                else if (nx == '\\')
-                    s.push_back('\\');
-                else
-                    s.push_back(nx);
-            }
-            else
-            {
-                s.push_back(ch);
+                escaped = true;
+                get();
             }
         }
-        return Token(TokenKind::STRING, s, line);
+        std::string_view s = src.substr(begin, i - 1 - begin);
+        return Token(TokenKind::STRING, s, line, escaped);
     }
 
     // 未知Token
     get();
-    return Token(TokenKind::UNKNOWN, std::string(1, c), line);
-}
\ No newline at end of file
+    return Token(TokenKind::UNKNOWN, src.substr(i - 1, 1), line);
+}
+
+void TokenBuffer::fill()
+{
+    // One slot stays free so the token consumed last is not overwritten
+    while (!done && avail < kCapacity - 1)
+    {
+        Token &t = ring[(head + avail) & (kCapacity - 1)];
+        t = lex.nextToken();
+        ++avail;
+        done = t.kind == TokenKind::END;
+    }
+}
+
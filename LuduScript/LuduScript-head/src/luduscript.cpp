@@ -0,0 +1,81 @@
+#include "luduscript.h"
+#include "bytecode.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "vm.h"
+#include <stdexcept>
+
+namespace luduscript
+{
+    struct CompiledProgram::Data
+    {
+        std::unique_ptr<Program> ast;
+        BytecodeProgram bytecode;
+    };
+
+    const Program &CompiledProgram::ast() const
+    {
+        return *data->ast;
+    }
+
+    const BytecodeProgram &CompiledProgram::bytecode() const
+    {
+        return data->bytecode;
+    }
+
+    CompiledProgram Compile(std::string_view source, bool arena)
+    {
+        auto data = std::make_shared<CompiledProgram::Data>();
+        data->ast = Parser(source, arena).parseProgram();
+        Optimizer().optimize(*data->ast);
+        data->bytecode = Compiler().compile(*data->ast);
+
+        CompiledProgram program;
+        program.data = std::move(data);
+        return program;
+    }
+
+    namespace
+    {
+        // Every run gets its own interpreter or VM; the program is only read
+        void run(const CompiledProgram &program, ObjectSink *sink, const ExecuteOptions &opts, std::string *output)
+        {
+            if (!program)
+                throw std::runtime_error("Executing an empty CompiledProgram");
+
+            if (opts.engine == Engine::VM)
+            {
+                VM vm;
+                vm.setSink(sink);
+                vm.setFieldOrder(opts.fieldOrder);
+                vm.execute(program.bytecode());
+                if (output)
+                    *output = vm.getOutput(opts.pretty);
+            }
+            else
+            {
+                Interpreter interpreter;
+                interpreter.setSink(sink);
+                interpreter.setFieldOrder(opts.fieldOrder);
+                interpreter.setJobs(opts.jobs);
+                interpreter.execute(&program.ast());
+                if (output)
+                    *output = interpreter.getOutput(opts.pretty);
+            }
+        }
+    }
+
+    void Execute(const CompiledProgram &program, ObjectSink &sink, const ExecuteOptions &opts)
+    {
+        run(program, &sink, opts, nullptr);
+        sink.finish();
+    }
+
+    std::string Execute(const CompiledProgram &program, const ExecuteOptions &opts)
+    {
+        std::string output;
+        run(program, nullptr, opts, &output);
+        return output;
+    }
+}
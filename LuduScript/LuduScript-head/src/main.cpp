@@ -1,87 +1,231 @@
-#include "parser.h"
-#include "interpreter.h"
+#include "driver.h"
+#include "batch.h"
+#include "source.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
 
-int main_inner(const std::string &source, bool printPretty, const std::string &outputFile = "")
+// Thread count for --jobs; 0 means one per hardware thread
+static unsigned parseJobs(const std::string &s)
 {
-    try
-    {
-        Parser parser(source);
-        auto program = parser.parseProgram();
-
-        Interpreter interpreter;
-        interpreter.execute(program.get());
-
-        // Generate output string
-        std::string jsonOutput = interpreter.getOutput(printPretty);
-
-        // Output to file or console
-        if (!outputFile.empty())
-        {
-            std::ofstream ofs(outputFile);
-            if (!ofs)
-            {
-                std::cerr << "Cannot write to " << outputFile << std::endl;
-                return 3;
-            }
-            ofs << jsonOutput << std::endl;
-            std::cout << "Output saved to " << outputFile << std::endl;
-        }
-        else
-        {
-            std::cout << jsonOutput << std::endl;
-        }
-        return 0;
-    }
-    catch (const std::exception &ex)
-    {
-        std::cerr << "Error: " << ex.what() << std::endl;
-        return 1;
-    }
+    long n = std::strtol(s.c_str(), nullptr, 10);
+    if (n <= 0)
+        return std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(n);
 }
 
 int main(int argc, char **argv)
 {
     if (argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " <script.file> [--pretty] [--output <file.json>]\n";
+        std::cerr << "Usage: " << argv[0] << " <script.file> [--pretty] [--output <file.json>] [--format=json|columnar] [--field-order=sorted|declared] [--engine=tree|vm] [--arena] [--stream[=array|ndjson]] [--dump-ast] [--jobs N] [--profile[=<file.json>]] [--incremental[=<cache>]] [--compile-cache <dir>]\n"
+                  << "       " << argv[0] << " --batch <dir|manifest> [--out-dir <dir>] [--summary <file.json>] [--jobs N] [--pretty] [--format=json|columnar] [--field-order=sorted|declared] [--engine=tree|vm] [--arena] [--stream[=array|ndjson]] [--compile-cache <dir>]\n";
         return 1;
     }
 
-    bool pretty = false;
-    std::string outputFile = "";
+    RunOptions opts;
     std::string path = argv[1];
 
+    // Batch mode: many scripts in one process, --jobs sets the number of scripts run at once
+    bool batchMode = path == "--batch";
+    BatchOptions batch;
+    int first = 2;
+    if (batchMode)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "--batch needs a directory or manifest" << std::endl;
+            return 1;
+        }
+        batch.input = argv[2];
+        first = 3;
+    }
+
     // Parse command line arguments
-    for (int i = 2; i < argc; i++)
+    for (int i = first; i < argc; i++)
     {
         std::string arg = argv[i];
         if (arg == "--pretty" || arg == "-p")
         {
-            pretty = true;
+            opts.pretty = true;
         }
         else if ((arg == "--output" || arg == "-o") && i + 1 < argc)
         {
-            outputFile = argv[i + 1];
+            opts.outputFile = argv[i + 1];
             i++;
         }
         else if (arg.substr(0, 9) == "--output=")
         {
-            outputFile = arg.substr(9);
+            opts.outputFile = arg.substr(9);
+        }
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            opts.format = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 9) == "--format=")
+        {
+            opts.format = arg.substr(9);
+        }
+        else if (arg == "--field-order" && i + 1 < argc)
+        {
+            opts.fieldOrder = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 14) == "--field-order=")
+        {
+            opts.fieldOrder = arg.substr(14);
+        }
+        else if (arg == "--engine" && i + 1 < argc)
+        {
+            opts.engine = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 9) == "--engine=")
+        {
+            opts.engine = arg.substr(9);
+        }
+        else if (arg == "--arena")
+        {
+            opts.arena = true;
+        }
+        else if ((arg == "--jobs" || arg == "-j") && i + 1 < argc)
+        {
+            opts.jobs = parseJobs(argv[i + 1]);
+            i++;
+        }
+        else if (arg.substr(0, 7) == "--jobs=")
+        {
+            opts.jobs = parseJobs(arg.substr(7));
+        }
+        else if (arg == "--out-dir" && i + 1 < argc)
+        {
+            batch.outDir = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 10) == "--out-dir=")
+        {
+            batch.outDir = arg.substr(10);
+        }
+        else if (arg == "--summary" && i + 1 < argc)
+        {
+            batch.summaryFile = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 10) == "--summary=")
+        {
+            batch.summaryFile = arg.substr(10);
+        }
+        else if (arg == "--dump-ast")
+        {
+            opts.dumpAst = true;
+        }
+        else if (arg == "--profile")
+        {
+            opts.profile = "profile.json";
+        }
+        else if (arg.substr(0, 10) == "--profile=")
+        {
+            opts.profile = arg.substr(10);
+        }
+        else if (arg == "--compile-cache" && i + 1 < argc)
+        {
+            opts.compileCache = argv[i + 1];
+            i++;
+        }
+        else if (arg.substr(0, 16) == "--compile-cache=")
+        {
+            opts.compileCache = arg.substr(16);
+        }
+        else if (arg == "--incremental")
+        {
+            opts.cacheFile = path + ".ldcache";
+        }
+        else if (arg.substr(0, 14) == "--incremental=")
+        {
+            opts.cacheFile = arg.substr(14);
+        }
+        else if (arg == "--stream")
+        {
+            opts.stream = "array";
+        }
+        else if (arg.substr(0, 9) == "--stream=")
+        {
+            opts.stream = arg.substr(9);
+        }
+    }
+
+    if (opts.engine != "tree" && opts.engine != "vm")
+    {
+        std::cerr << "Unknown engine: " << opts.engine << " (expected tree or vm)" << std::endl;
+        return 1;
+    }
+    if (!opts.stream.empty() && opts.stream != "array" && opts.stream != "ndjson")
+    {
+        std::cerr << "Unknown stream framing: " << opts.stream << " (expected array or ndjson)" << std::endl;
+        return 1;
+    }
+
+    if (opts.format != "json" && opts.format != "columnar")
+    {
+        std::cerr << "Unknown format: " << opts.format << " (expected json or columnar)" << std::endl;
+        return 1;
+    }
+    if (opts.fieldOrder != "sorted" && opts.fieldOrder != "declared")
+    {
+        std::cerr << "Unknown field order: " << opts.fieldOrder << " (expected sorted or declared)" << std::endl;
+        return 1;
+    }
+    if (opts.format == "columnar")
+    {
+        // Columns are laid out once every object is known, and the binary file needs a destination
+        if (!opts.stream.empty() || opts.pretty)
+        {
+            std::cerr << "--format=columnar cannot be used with --stream or --pretty" << std::endl;
+            return 1;
+        }
+        if (!batchMode && opts.outputFile.empty() && !opts.dumpAst)
+        {
+            std::cerr << "--format=columnar needs --output <file.ldcol>" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!opts.profile.empty())
+    {
+        if (opts.engine != "tree" || batchMode)
+        {
+            std::cerr << "--profile needs the tree engine and a single script" << std::endl;
+            return 1;
+        }
+        // Parallel loops would time their workers outside the statement tree
+        opts.jobs = 1;
+    }
+
+    if (!opts.cacheFile.empty() && (opts.engine != "tree" || batchMode))
+    {
+        std::cerr << "--incremental needs the tree engine and a single script" << std::endl;
+        return 1;
+    }
+
+    if (batchMode)
+    {
+        if (!opts.outputFile.empty() || opts.dumpAst)
+        {
+            std::cerr << "--output and --dump-ast cannot be used with --batch (see --out-dir)" << std::endl;
+            return 1;
         }
+        batch.threads = opts.jobs;
+        return runBatch(batch, opts, std::cout, std::cerr);
     }
 
-    std::ifstream ifs(path);
-    if (!ifs)
+    SourceBuffer source;
+    if (!source.load(path))
     {
         std::cerr << "Cannot open " << path << std::endl;
         return 2;
     }
-    std::stringstream ss;
-    ss << ifs.rdbuf();
-    std::string src = ss.str();
-    return main_inner(src, pretty, outputFile);
+    return runScript(source.view(), opts, std::cout, std::cerr);
 }
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include "optimizer.h"
+
+void Optimizer::optimize(Program &p)
+{
+    program = &p;
+    optimizeBody(p.stmts);
+    program = nullptr;
+}
+
+std::optional<Value> Optimizer::literalValue(const Expr *e) const
+{
+    if (e->kind != NodeKind::LITERAL)
+        return std::nullopt;
+    auto lit = static_cast<const LiteralExpr *>(e);
+    switch (lit->litKind)
+    {
+    case LiteralExpr::Kind::INTEGER:
+        return Value::makeInt(lit->ival);
+    case LiteralExpr::Kind::FLOAT:
+        return Value::makeNum(lit->dval);
+    case LiteralExpr::Kind::STRING:
+        return Value::makeStr(program->strings->str(lit->sval));
+    case LiteralExpr::Kind::BOOL:
+        return Value::makeBool(lit->bval);
+    }
+    return std::nullopt;
+}
+
+ExprPtr Optimizer::makeLiteral(const Value &v, int line)
+{
+    Arena *arena = program->arena.get();
+    switch (v.type())
+    {
+    case Value::Type::NUM:
+        if (v.isInt())
+            return makeNode<LiteralExpr>(arena, v.intVal(), line);
+        return makeNode<LiteralExpr>(arena, v.numVal(), line);
+    case Value::Type::STR:
+        return makeNode<LiteralExpr>(arena, program->strings->intern(v.strVal()), line);
+    case Value::Type::BOOL:
+        return makeNode<LiteralExpr>(arena, v.boolVal(), line);
+    }
+    return nullptr;
+}
+
+void Optimizer::foldExpr(ExprPtr &e)
+{
+    switch (e->kind)
+    {
+    case NodeKind::UNARY:
+    {
+        auto u = static_cast<UnaryExpr *>(e.get());
+        foldExpr(u->rhs);
+        auto r = literalValue(u->rhs.get());
+        if (!r)
+            return;
+        e = makeLiteral(ops::unary(u->op, *r), e->line);
+        return;
+    }
+    case NodeKind::BINARY:
+    {
+        auto b = static_cast<BinaryExpr *>(e.get());
+        foldExpr(b->lhs);
+        foldExpr(b->rhs);
+        auto l = literalValue(b->lhs.get());
+        // A literal left operand that decides && / || drops the right one, which never runs
+        if (l && (b->op == BinaryOp::AND || b->op == BinaryOp::OR) && l->toBool() == (b->op == BinaryOp::OR))
+        {
+            e = makeLiteral(Value::makeBool(l->toBool()), e->line);
+            return;
+        }
+        auto r = literalValue(b->rhs.get());
+        if (!l || !r)
+            return;
+
+        Value v;
+        try
+        {
+            v = ops::binary(b->op, *l, *r);
+        }
+        catch (const std::exception &)
+        {
+            // Division by zero and the like must still fail at runtime, with the statement's line
+            return;
+        }
+        e = makeLiteral(v, e->line);
+        return;
+    }
+    case NodeKind::CALL:
+    {
+        auto c = static_cast<CallExpr *>(e.get());
+        foldExpr(c->callee);
+        for (auto &arg : c->args)
+            foldExpr(arg);
+        return;
+    }
+    case NodeKind::ACCESS:
+        foldExpr(static_cast<AccessExpr *>(e.get())->target);
+        return;
+    default:
+        return;
+    }
+}
+
+void Optimizer::optimizeBody(std::vector<StmtPtr> &body)
+{
+    for (auto &st : body)
+        optimizeStmt(st.get());
+}
+
+void Optimizer::optimizeStmt(Stmt *s)
+{
+    switch (s->kind)
+    {
+    case NodeKind::EXPR_STMT:
+        foldExpr(static_cast<ExprStmt *>(s)->expr);
+        break;
+    case NodeKind::ASSIGN:
+        foldExpr(static_cast<AssignStmt *>(s)->expr);
+        break;
+    case NodeKind::DECL:
+    {
+        auto ds = static_cast<DeclStmt *>(s);
+        if (ds->init.has_value())
+            foldExpr(*ds->init);
+        optimizeBody(ds->initBlock);
+        simplifyDecl(ds);
+        break;
+    }
+    case NodeKind::IF:
+    {
+        auto is = static_cast<IfStmt *>(s);
+        foldExpr(is->cond);
+        optimizeBody(is->thenBody);
+        for (auto &elif : is->elifs)
+        {
+            foldExpr(elif.first);
+            optimizeBody(elif.second);
+        }
+        optimizeBody(is->elseBody);
+        pruneIf(is);
+        break;
+    }
+    case NodeKind::FOR:
+    {
+        auto fs = static_cast<ForStmt *>(s);
+        for (auto &arg : fs->args)
+            foldExpr(arg);
+        optimizeBody(fs->body);
+        break;
+    }
+    case NodeKind::OBJ:
+    {
+        auto os = static_cast<ObjStmt *>(s);
+        foldExpr(os->idExpr);
+        optimizeBody(os->body);
+        break;
+    }
+    case NodeKind::BREAK:
+        optimizeBody(static_cast<BreakStmt *>(s)->body);
+        break;
+    case NodeKind::CONTINUE:
+        optimizeBody(static_cast<ContinueStmt *>(s)->body);
+        break;
+    default:
+        break;
+    }
+}
+
+// The IfStmt itself stays in place: as the last statement of an init block it yields 0.0
+// when no branch runs, and every branch keeps the scope layout the Resolver gave it
+void Optimizer::pruneIf(IfStmt *is)
+{
+    // A literal false condition hands over to the first elif, or leaves only the else branch
+    while (auto c = literalValue(is->cond.get()))
+    {
+        if (c->toBool())
+        {
+            is->elifs.clear();
+            is->elifSlots.clear();
+            is->elseBody.clear();
+            is->elseSlots = 0;
+            return;
+        }
+        if (is->elifs.empty())
+        {
+            // Only the else branch can run: keep the false condition, the else body does the work
+            is->thenBody.clear();
+            is->thenSlots = 0;
+            return;
+        }
+        is->cond = std::move(is->elifs.front().first);
+        is->thenBody = std::move(is->elifs.front().second);
+        is->thenSlots = is->elifSlots.front();
+        is->elifs.erase(is->elifs.begin());
+        is->elifSlots.erase(is->elifSlots.begin());
+    }
+
+    for (size_t i = 0; i < is->elifs.size();)
+    {
+        auto c = literalValue(is->elifs[i].first.get());
+        if (!c)
+        {
+            ++i;
+            continue;
+        }
+        if (!c->toBool())
+        {
+            is->elifs.erase(is->elifs.begin() + i);
+            is->elifSlots.erase(is->elifSlots.begin() + i);
+            continue;
+        }
+        // A true elif always runs when reached: it becomes the else branch
+        is->elseBody = std::move(is->elifs[i].second);
+        is->elseSlots = is->elifSlots[i];
+        is->elifs.erase(is->elifs.begin() + i, is->elifs.end());
+        is->elifSlots.erase(is->elifSlots.begin() + i, is->elifSlots.end());
+        return;
+    }
+}
+
+// Value of an init block known without running it, see Interpreter::execDecl
+std::optional<Value> Optimizer::constantBlockValue(const std::vector<StmtPtr> &body) const
+{
+    if (body.size() != 1)
+        return std::nullopt;
+    const Stmt *st = body[0].get();
+    if (st->kind == NodeKind::EXPR_STMT)
+        return literalValue(static_cast<const ExprStmt *>(st)->expr.get());
+    if (st->kind != NodeKind::IF)
+        return std::nullopt;
+
+    // A trailing if yields the last expression of the branch that runs, or 0.0
+    auto is = static_cast<const IfStmt *>(st);
+    auto c = literalValue(is->cond.get());
+    if (!c || !is->elifs.empty())
+        return std::nullopt;
+    const std::vector<StmtPtr> &branch = c->toBool() ? is->thenBody : is->elseBody;
+    if (branch.empty())
+        return Value::makeNum(0.0);
+    if (branch.size() == 1 && branch[0]->kind == NodeKind::EXPR_STMT)
+        return literalValue(static_cast<const ExprStmt *>(branch[0].get())->expr.get());
+    return std::nullopt;
+}
+
+void Optimizer::simplifyDecl(DeclStmt *ds)
+{
+    if (ds->initBlock.empty())
+        return;
+    auto v = constantBlockValue(ds->initBlock);
+    if (!v)
+        return;
+    ds->init = makeLiteral(*v, ds->line);
+    ds->initBlock.clear();
+    ds->initSlots = 0;
+    ds->result = VarBinding();
+}
@@ -1,26 +1,16 @@
 #include "parser.h"
+#include "resolver.h"
 #include <algorithm>
 
-Parser::Parser(std::string src) : lex(std::move(src))
+Parser::Parser(std::string_view src, bool useArena) : tokens(src), cur(&tokens.peek()), strings(std::make_shared<StringTable>())
 {
-    cur = lex.nextToken();
-}
-
-Token Parser::peek()
-{
-    return cur;
-}
-
-Token Parser::consume()
-{
-    Token t = cur;
-    cur = lex.nextToken();
-    return t;
+    if (useArena)
+        arena = std::make_unique<Arena>();
 }
 
 bool Parser::match(TokenKind k)
 {
-    if (cur.kind == k)
+    if (cur->kind == k)
     {
         consume();
         return true;
@@ -28,9 +18,9 @@ bool Parser::match(TokenKind k)
     return false;
 }
 
-void Parser::expect(TokenKind k, const std::string &msg)
+void Parser::expect(TokenKind k, const char *msg)
 {
-    if (cur.kind != k)
+    if (cur->kind != k)
     {
         error(msg);
     }
@@ -41,97 +31,99 @@ void Parser::expect(TokenKind k, const std::string &msg)
 void Parser::error(const std::string &msg)
 {
     std::ostringstream oss;
-    oss << "Parse error (line " << cur.line << "): " << msg << " but got '" << cur.text << "'";
+    oss << "Parse error (line " << cur->line << "): " << msg << " but got '" << cur->str() << "'";
     throw std::runtime_error(oss.str());
 }
 
 bool Parser::isExpressionStart()
 {
-    return cur.kind == TokenKind::NUMBER ||
-           cur.kind == TokenKind::STRING ||
-           cur.kind == TokenKind::IDENT ||
-           cur.kind == TokenKind::KW_TRUE ||
-           cur.kind == TokenKind::KW_FALSE ||
-           cur.kind == TokenKind::LPAREN ||
-           cur.kind == TokenKind::MINUS ||
-           cur.kind == TokenKind::NOT;
+    return cur->kind == TokenKind::NUMBER ||
+           cur->kind == TokenKind::STRING ||
+           cur->kind == TokenKind::IDENT ||
+           cur->kind == TokenKind::KW_TRUE ||
+           cur->kind == TokenKind::KW_FALSE ||
+           cur->kind == TokenKind::LPAREN ||
+           cur->kind == TokenKind::MINUS ||
+           cur->kind == TokenKind::NOT;
 }
 
 std::unique_ptr<Program> Parser::parseProgram()
 {
     auto prog = std::make_unique<Program>();
-    while (cur.kind != TokenKind::END)
+    prog->strings = strings;
+    while (cur->kind != TokenKind::END)
     {
         prog->stmts.push_back(parseStmt());
     }
+
+    prog->arena = std::move(arena);
+
+    // Bind every variable to its scope slot before execution
+    Resolver().resolve(*prog);
     return prog;
 }
 
 StmtPtr Parser::parseStmt()
 {
-    if (cur.kind == TokenKind::KW_IF)
+    if (cur->kind == TokenKind::KW_IF)
         return parseIf();
-    if (cur.kind == TokenKind::KW_FOR)
+    if (cur->kind == TokenKind::KW_FOR)
         return parseFor();
-    if (cur.kind == TokenKind::KW_OBJ)
+    if (cur->kind == TokenKind::KW_OBJ)
         return parseObj();
-    if (cur.kind == TokenKind::KW_NUM || cur.kind == TokenKind::KW_STR || cur.kind == TokenKind::KW_BOOL)
+    if (cur->kind == TokenKind::KW_NUM || cur->kind == TokenKind::KW_STR || cur->kind == TokenKind::KW_BOOL)
         return parseDecl();
-    if (cur.kind == TokenKind::KW_BREAK)
+    if (cur->kind == TokenKind::KW_BREAK)
     {
-        int line = cur.line;
+        int line = cur->line;
         consume();
         auto body = parseBlock();
-        return std::make_unique<BreakStmt>(std::move(body), line);
+        return node<BreakStmt>(std::move(body), line);
     }
-    if (cur.kind == TokenKind::KW_CONTINUE)
+    if (cur->kind == TokenKind::KW_CONTINUE)
     {
-        int line = cur.line;
+        int line = cur->line;
         consume();
         auto body = parseBlock();
-        return std::make_unique<ContinueStmt>(std::move(body), line);
+        return node<ContinueStmt>(std::move(body), line);
     }
 
     // Check for assignment: IDENT = expr
-    if (cur.kind == TokenKind::IDENT)
+    if (cur->kind == TokenKind::IDENT)
     {
-        // 需要前瞻来判断是否为赋值语句
-        // 创建临时词法分析器来检查下一个token
-        Lexer tempLex = lex;                   // 复制当前词法分析器状态
-        Token tempToken = tempLex.nextToken(); // 获取下一个token
-
-        if (tempToken.kind == TokenKind::ASSIGN)
+        // 需要前瞻一个token来判断是否为赋值语句
+        if (peek(1).kind == TokenKind::ASSIGN)
         {
             // 这是赋值语句
-            int line = cur.line;
-            std::string name = cur.text;
+            int line = cur->line;
+            Symbol name = intern(cur->text);
             consume(); // consume IDENT
             expect(TokenKind::ASSIGN, "Expected '='");
             auto expr = parseExpr();
             match(TokenKind::SEMI); // Optional semicolon
-            return std::make_unique<AssignStmt>(name, std::move(expr), line);
+            return node<AssignStmt>(name, std::move(expr), line);
         }
     }
 
     // Expression statement
     auto expr = parseExpr();
     match(TokenKind::SEMI); // Optional semicolon
-    return std::make_unique<ExprStmt>(std::move(expr), expr->line);
+    return node<ExprStmt>(std::move(expr), expr->line);
 }
 
 StmtPtr Parser::parseIf()
 {
-    int line = cur.line;
+    int line = cur->line;
     expect(TokenKind::KW_IF, "Expected 'if'");
     expect(TokenKind::LPAREN, "Expected '(' after 'if'");
     auto cond = parseExpr();
     expect(TokenKind::RPAREN, "Expected ')' after if condition");
 
-    auto ifStmt = std::make_unique<IfStmt>(std::move(cond), line);
+    auto ifStmt = node<IfStmt>(std::move(cond), line);
     ifStmt->thenBody = parseBlock();
 
     // Handle elif clauses
-    while (cur.kind == TokenKind::KW_ELIF)
+    while (cur->kind == TokenKind::KW_ELIF)
     {
         consume(); // consume 'elif'
         expect(TokenKind::LPAREN, "Expected '(' after 'elif'");
@@ -142,7 +134,7 @@ StmtPtr Parser::parseIf()
     }
 
     // Handle else clause
-    if (cur.kind == TokenKind::KW_ELSE)
+    if (cur->kind == TokenKind::KW_ELSE)
     {
         consume(); // consume 'else'
         ifStmt->elseBody = parseBlock();
@@ -153,18 +145,18 @@ StmtPtr Parser::parseIf()
 
 StmtPtr Parser::parseFor()
 {
-    int line = cur.line;
+    int line = cur->line;
     expect(TokenKind::KW_FOR, "Expected 'for'");
     expect(TokenKind::LPAREN, "Expected '(' after 'for'");
 
-    if (cur.kind != TokenKind::IDENT)
+    if (cur->kind != TokenKind::IDENT)
         error("Expected iterator variable name");
-    std::string iter = cur.text;
+    Symbol iter = intern(cur->text);
     consume();
 
     expect(TokenKind::COMMA, "Expected ',' after iterator variable");
 
-    auto forStmt = std::make_unique<ForStmt>(iter, line);
+    auto forStmt = node<ForStmt>(iter, line);
 
     // Parse arguments (1-3 expressions)
     forStmt->args.push_back(parseExpr());
@@ -185,20 +177,20 @@ StmtPtr Parser::parseFor()
 
 StmtPtr Parser::parseObj()
 {
-    int line = cur.line;
+    int line = cur->line;
     expect(TokenKind::KW_OBJ, "Expected 'obj'");
     expect(TokenKind::LPAREN, "Expected '(' after 'obj'");
 
-    if (cur.kind != TokenKind::STRING)
+    if (cur->kind != TokenKind::STRING)
         error("Expected class name string");
-    std::string className = cur.text;
+    Symbol className = internLiteral(*cur);
     consume();
 
     expect(TokenKind::COMMA, "Expected ',' after class name");
     auto idExpr = parseExpr();
     expect(TokenKind::RPAREN, "Expected ')' after object id");
 
-    auto objStmt = std::make_unique<ObjStmt>(className, std::move(idExpr), line);
+    auto objStmt = node<ObjStmt>(className, std::move(idExpr), line);
     objStmt->body = parseBlock();
 
     return objStmt;
@@ -206,15 +198,15 @@ StmtPtr Parser::parseObj()
 
 StmtPtr Parser::parseDecl()
 {
-    int line = cur.line;
-    std::string type = cur.text;
+    int line = cur->line;
+    std::string type(cur->text);
     consume(); // consume type keyword
 
     expect(TokenKind::LPAREN, "Expected '(' after type");
 
-    if (cur.kind != TokenKind::IDENT)
+    if (cur->kind != TokenKind::IDENT)
         error("Expected variable name");
-    std::string name = cur.text;
+    Symbol name = intern(cur->text);
     consume();
 
     expect(TokenKind::RPAREN, "Expected ')' after variable name");
@@ -225,13 +217,13 @@ StmtPtr Parser::parseDecl()
     if (match(TokenKind::LBRACE))
     {
         // Check if it's an empty initializer block (default value)
-        if (cur.kind != TokenKind::RBRACE)
+        if (cur->kind != TokenKind::RBRACE)
         {
             // Try to parse as a single expression first
             if (isExpressionStart())
             {
                 auto expr = parseExpr();
-                if (cur.kind == TokenKind::RBRACE)
+                if (cur->kind == TokenKind::RBRACE)
                 {
                     // Single expression case
                     init = std::move(expr);
@@ -239,8 +231,8 @@ StmtPtr Parser::parseDecl()
                 else
                 {
                     // Multiple statements case - convert first expression to statement
-                    initBlock.push_back(std::make_unique<ExprStmt>(std::move(expr), cur.line));
-                    while (cur.kind != TokenKind::RBRACE && cur.kind != TokenKind::END)
+                    initBlock.push_back(node<ExprStmt>(std::move(expr), cur->line));
+                    while (cur->kind != TokenKind::RBRACE && cur->kind != TokenKind::END)
                     {
                         initBlock.push_back(parseStmt());
                     }
@@ -249,7 +241,7 @@ StmtPtr Parser::parseDecl()
             else
             {
                 // Parse statements in the block
-                while (cur.kind != TokenKind::RBRACE && cur.kind != TokenKind::END)
+                while (cur->kind != TokenKind::RBRACE && cur->kind != TokenKind::END)
                 {
                     initBlock.push_back(parseStmt());
                 }
@@ -263,11 +255,11 @@ StmtPtr Parser::parseDecl()
     // Use block constructor if we have statements, otherwise use expression constructor
     if (!initBlock.empty())
     {
-        return std::make_unique<DeclStmt>(type, name, std::move(initBlock), line);
+        return node<DeclStmt>(type, name, std::move(initBlock), line);
     }
     else
     {
-        return std::make_unique<DeclStmt>(type, name, std::move(init), line);
+        return node<DeclStmt>(type, name, std::move(init), line);
     }
 }
 
@@ -276,7 +268,7 @@ std::vector<StmtPtr> Parser::parseBlock()
     expect(TokenKind::LBRACE, "Expected '{'");
     std::vector<StmtPtr> stmts;
 
-    while (cur.kind != TokenKind::RBRACE && cur.kind != TokenKind::END)
+    while (cur->kind != TokenKind::RBRACE && cur->kind != TokenKind::END)
     {
         stmts.push_back(parseStmt());
     }
@@ -1,5 +1,41 @@
 #include "parser.h"
 
+namespace
+{
+    BinaryOp binaryOp(TokenKind k)
+    {
+        switch (k)
+        {
+        case TokenKind::PLUS:
+            return BinaryOp::ADD;
+        case TokenKind::MINUS:
+            return BinaryOp::SUB;
+        case TokenKind::MUL:
+            return BinaryOp::MUL;
+        case TokenKind::DIV:
+            return BinaryOp::DIV;
+        case TokenKind::MOD:
+            return BinaryOp::MOD;
+        case TokenKind::EQ:
+            return BinaryOp::EQ;
+        case TokenKind::NEQ:
+            return BinaryOp::NEQ;
+        case TokenKind::LT:
+            return BinaryOp::LT;
+        case TokenKind::GT:
+            return BinaryOp::GT;
+        case TokenKind::LE:
+            return BinaryOp::LE;
+        case TokenKind::GE:
+            return BinaryOp::GE;
+        case TokenKind::AND:
+            return BinaryOp::AND;
+        default:
+            return BinaryOp::OR;
+        }
+    }
+}
+
 ExprPtr Parser::parseExpr()
 {
     return parseLogicalOr();
@@ -9,13 +45,13 @@ ExprPtr Parser::parseLogicalOr()
 {
     auto left = parseLogicalAnd();
 
-    while (cur.kind == TokenKind::OR)
+    while (cur->kind == TokenKind::OR)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseLogicalAnd();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -25,13 +61,13 @@ ExprPtr Parser::parseLogicalAnd()
 {
     auto left = parseEquality();
 
-    while (cur.kind == TokenKind::AND)
+    while (cur->kind == TokenKind::AND)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseEquality();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -41,13 +77,13 @@ ExprPtr Parser::parseEquality()
 {
     auto left = parseComparison();
 
-    while (cur.kind == TokenKind::EQ || cur.kind == TokenKind::NEQ)
+    while (cur->kind == TokenKind::EQ || cur->kind == TokenKind::NEQ)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseComparison();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -57,14 +93,14 @@ ExprPtr Parser::parseComparison()
 {
     auto left = parseAddition();
 
-    while (cur.kind == TokenKind::LT || cur.kind == TokenKind::GT ||
-           cur.kind == TokenKind::LE || cur.kind == TokenKind::GE)
+    while (cur->kind == TokenKind::LT || cur->kind == TokenKind::GT ||
+           cur->kind == TokenKind::LE || cur->kind == TokenKind::GE)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseAddition();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -74,13 +110,13 @@ ExprPtr Parser::parseAddition()
 {
     auto left = parseMultiplication();
 
-    while (cur.kind == TokenKind::PLUS || cur.kind == TokenKind::MINUS)
+    while (cur->kind == TokenKind::PLUS || cur->kind == TokenKind::MINUS)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseMultiplication();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -90,13 +126,13 @@ ExprPtr Parser::parseMultiplication()
 {
     auto left = parseUnary();
 
-    while (cur.kind == TokenKind::MUL || cur.kind == TokenKind::DIV || cur.kind == TokenKind::MOD)
+    while (cur->kind == TokenKind::MUL || cur->kind == TokenKind::DIV || cur->kind == TokenKind::MOD)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        BinaryOp op = binaryOp(cur->kind);
+        int line = cur->line;
         consume();
         auto right = parseUnary();
-        left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
+        left = node<BinaryExpr>(std::move(left), op, std::move(right), line);
     }
 
     return left;
@@ -104,13 +140,13 @@ ExprPtr Parser::parseMultiplication()
 
 ExprPtr Parser::parseUnary()
 {
-    if (cur.kind == TokenKind::NOT || cur.kind == TokenKind::MINUS)
+    if (cur->kind == TokenKind::NOT || cur->kind == TokenKind::MINUS)
     {
-        std::string op = cur.text;
-        int line = cur.line;
+        UnaryOp op = cur->kind == TokenKind::NOT ? UnaryOp::NOT : UnaryOp::NEG;
+        int line = cur->line;
         consume();
         auto right = parseUnary();
-        return std::make_unique<UnaryExpr>(op, std::move(right), line);
+        return node<UnaryExpr>(op, std::move(right), line);
     }
 
     return parsePrimary();
@@ -118,12 +154,12 @@ ExprPtr Parser::parseUnary()
 
 ExprPtr Parser::parsePrimary()
 {
-    int line = cur.line;
+    int line = cur->line;
 
     // Numbers (integers and floating point)
-    if (cur.kind == TokenKind::NUMBER)
+    if (cur->kind == TokenKind::NUMBER)
     {
-        std::string text = cur.text;
+        std::string text(cur->text);
         consume();
 
         ExprPtr expr;
@@ -131,52 +167,52 @@ ExprPtr Parser::parsePrimary()
         if (text.find('.') != std::string::npos)
         {
             double value = std::stod(text);
-            expr = std::make_unique<LiteralExpr>(value, line);
+            expr = node<LiteralExpr>(value, line);
         }
         else
         {
             ll value = std::stoll(text);
-            expr = std::make_unique<LiteralExpr>(value, line);
+            expr = node<LiteralExpr>(value, line);
         }
 
         return parseCall(std::move(expr));
     }
 
     // Strings
-    if (cur.kind == TokenKind::STRING)
+    if (cur->kind == TokenKind::STRING)
     {
-        std::string value = cur.text;
+        Symbol value = internLiteral(*cur);
         consume();
-        auto expr = std::make_unique<LiteralExpr>(value, line);
+        auto expr = node<LiteralExpr>(value, line);
         return parseCall(std::move(expr));
     }
 
     // Boolean literals
-    if (cur.kind == TokenKind::KW_TRUE)
+    if (cur->kind == TokenKind::KW_TRUE)
     {
         consume();
-        auto expr = std::make_unique<LiteralExpr>(true, line);
+        auto expr = node<LiteralExpr>(true, line);
         return parseCall(std::move(expr));
     }
 
-    if (cur.kind == TokenKind::KW_FALSE)
+    if (cur->kind == TokenKind::KW_FALSE)
     {
         consume();
-        auto expr = std::make_unique<LiteralExpr>(false, line);
+        auto expr = node<LiteralExpr>(false, line);
         return parseCall(std::move(expr));
     }
 
     // Identifiers
-    if (cur.kind == TokenKind::IDENT)
+    if (cur->kind == TokenKind::IDENT)
     {
-        std::string name = cur.text;
+        Symbol name = intern(cur->text);
         consume();
-        auto expr = std::make_unique<IdentExpr>(name, line);
+        auto expr = node<IdentExpr>(name, line);
         return parseCall(std::move(expr));
     }
 
     // Parenthesized expressions
-    if (cur.kind == TokenKind::LPAREN)
+    if (cur->kind == TokenKind::LPAREN)
     {
         consume(); // consume '('
         auto expr = parseExpr();
@@ -191,14 +227,14 @@ ExprPtr Parser::parseCall(ExprPtr callee)
 {
     while (true)
     {
-        if (cur.kind == TokenKind::LPAREN)
+        if (cur->kind == TokenKind::LPAREN)
         {
             // Function call
-            int line = cur.line;
+            int line = cur->line;
             consume(); // consume '('
 
             std::vector<ExprPtr> args;
-            if (cur.kind != TokenKind::RPAREN)
+            if (cur->kind != TokenKind::RPAREN)
             {
                 args.push_back(parseExpr());
                 while (match(TokenKind::COMMA))
@@ -208,21 +244,21 @@ ExprPtr Parser::parseCall(ExprPtr callee)
             }
 
             expect(TokenKind::RPAREN, "Expected ')' after arguments");
-            callee = std::make_unique<CallExpr>(std::move(callee), std::move(args), line);
+            callee = node<CallExpr>(std::move(callee), std::move(args), line);
         }
-        else if (cur.kind == TokenKind::DOT)
+        else if (cur->kind == TokenKind::DOT)
         {
             // Member access
-            int line = cur.line;
+            int line = cur->line;
             consume(); // consume '.'
 
-            if (cur.kind != TokenKind::IDENT)
+            if (cur->kind != TokenKind::IDENT)
                 error("Expected member name after '.'");
 
-            std::string member = cur.text;
+            Symbol member = intern(cur->text);
             consume();
 
-            callee = std::make_unique<AccessExpr>(std::move(callee), member, line);
+            callee = node<AccessExpr>(std::move(callee), member, line);
         }
         else
         {
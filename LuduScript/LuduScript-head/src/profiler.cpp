@@ -0,0 +1,146 @@
+#include "profiler.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace
+{
+    // Short description of a statement for reports, e.g. "obj Card", "for i", "num cost"
+    std::string describe(const Stmt *s, const StringTable &strings)
+    {
+        switch (s->kind)
+        {
+        case NodeKind::EXPR_STMT:
+            return "expr";
+        case NodeKind::ASSIGN:
+            return "assign " + strings.str(static_cast<const AssignStmt *>(s)->name);
+        case NodeKind::DECL:
+        {
+            auto ds = static_cast<const DeclStmt *>(s);
+            return ds->type + " " + strings.str(ds->name);
+        }
+        case NodeKind::IF:
+            return "if";
+        case NodeKind::FOR:
+            return "for " + strings.str(static_cast<const ForStmt *>(s)->iter);
+        case NodeKind::OBJ:
+            return "obj " + strings.str(static_cast<const ObjStmt *>(s)->className);
+        case NodeKind::BREAK:
+            return "break";
+        case NodeKind::CONTINUE:
+            return "continue";
+        default:
+            return "?";
+        }
+    }
+
+    double ms(Profiler::Clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+Profiler::Profiler()
+{
+    contexts.emplace_back(nullptr);
+}
+
+void Profiler::start()
+{
+    stack.clear();
+    stack.emplace_back(0, Clock::now());
+}
+
+void Profiler::stop()
+{
+    // Statements still open after a runtime error have been left by their own guards
+    if (!stack.empty())
+    {
+        contexts[0].total += Clock::now() - stack.front().second;
+        contexts[0].hits++;
+        stack.clear();
+    }
+}
+
+uint32_t Profiler::child(uint32_t parent, const Stmt *s)
+{
+    auto [it, inserted] = index.try_emplace({parent, s}, static_cast<uint32_t>(contexts.size()));
+    if (inserted)
+    {
+        contexts.emplace_back(s);
+        contexts[parent].children.push_back(it->second);
+    }
+    return it->second;
+}
+
+void Profiler::writeTable(std::ostream &out, const StringTable &strings, size_t limit) const
+{
+    struct Row
+    {
+        uint64_t hits = 0;
+        Clock::duration inclusive{};
+        Clock::duration exclusive{};
+    };
+
+    // Fold contexts into (line, statement) rows; a statement's own time excludes its nested statements
+    std::map<std::pair<int, std::string>, Row> rows;
+    for (size_t i = 1; i < contexts.size(); ++i)
+    {
+        const Context &c = contexts[i];
+        Clock::duration nested{};
+        for (uint32_t ch : c.children)
+            nested += contexts[ch].total;
+        Row &row = rows[{c.stmt->line, describe(c.stmt, strings)}];
+        row.hits += c.hits;
+        row.inclusive += c.total;
+        row.exclusive += c.total - nested;
+    }
+
+    std::vector<std::pair<std::pair<int, std::string>, Row>> sorted(rows.begin(), rows.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+              { return a.second.exclusive > b.second.exclusive; });
+
+    double total = ms(contexts[0].total);
+    out << "Profile: " << std::fixed << std::setprecision(3) << total << " ms total, "
+        << sorted.size() << " statements (sorted by exclusive time)\n";
+    out << std::setw(6) << "line" << "  " << std::left << std::setw(28) << "statement" << std::right
+        << std::setw(12) << "hits" << std::setw(14) << "incl ms" << std::setw(14) << "excl ms" << std::setw(8) << "excl %" << "\n";
+    size_t shown = 0;
+    for (auto &[key, row] : sorted)
+    {
+        if (shown++ == limit)
+        {
+            out << "  ... " << sorted.size() - limit << " more\n";
+            break;
+        }
+        double excl = ms(row.exclusive);
+        out << std::setw(6) << key.first << "  " << std::left << std::setw(28) << key.second << std::right
+            << std::setw(12) << row.hits << std::setw(14) << std::setprecision(3) << ms(row.inclusive)
+            << std::setw(14) << excl << std::setw(8) << std::setprecision(1) << (total > 0 ? 100.0 * excl / total : 0.0) << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+void Profiler::writeFlameGraph(std::ostream &out, const StringTable &strings) const
+{
+    // Values are nanoseconds; every context also carries its hit count and source line
+    auto build = [&](auto &self, uint32_t i) -> nlohmann::json
+    {
+        const Context &c = contexts[i];
+        nlohmann::json node;
+        node["name"] = c.stmt ? "line " + std::to_string(c.stmt->line) + ": " + describe(c.stmt, strings) : std::string("program");
+        node["value"] = std::chrono::duration_cast<std::chrono::nanoseconds>(c.total).count();
+        node["hits"] = c.hits;
+        if (c.stmt)
+            node["line"] = c.stmt->line;
+        nlohmann::json children = nlohmann::json::array();
+        for (uint32_t ch : c.children)
+            children.push_back(self(self, ch));
+        node["children"] = std::move(children);
+        return node;
+    };
+    out << build(build, 0).dump() << "\n";
+}
@@ -0,0 +1,606 @@
+#include "program_cache.h"
+#include "arena.h"
+#include "source.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifndef LUDUSCRIPT_VERSION
+#define LUDUSCRIPT_VERSION "dev"
+#endif
+// Hash of the AST, frontend and serializer sources, computed by CMake at configure time
+#ifndef LUDUSCRIPT_CACHE_SCHEMA
+#define LUDUSCRIPT_CACHE_SCHEMA "unversioned"
+#endif
+
+namespace
+{
+    constexpr char kMagic[4] = {'L', 'D', 'P', 'C'};
+    // Layout of the file header; node layout and parser/optimizer output are covered by kSchema
+    constexpr uint32_t kFormat = 3;
+    constexpr const char *kCompilerVersion = LUDUSCRIPT_VERSION;
+    constexpr const char *kSchema = LUDUSCRIPT_CACHE_SCHEMA;
+
+    class Writer
+    {
+    public:
+        explicit Writer(std::string &out) : out(out) {}
+
+        template <class T>
+        void put(T v)
+        {
+            out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+        }
+        void str(std::string_view s)
+        {
+            put<uint32_t>(static_cast<uint32_t>(s.size()));
+            out.append(s.data(), s.size());
+        }
+
+        void binding(const VarBinding &b)
+        {
+            put<uint32_t>(static_cast<uint32_t>(b.candidates.size()));
+            for (const Slot &slot : b.candidates)
+            {
+                put<int32_t>(slot.depth);
+                put<int32_t>(slot.index);
+            }
+            put<int32_t>(b.own);
+        }
+
+        void expr(const Expr *e)
+        {
+            put<uint8_t>(static_cast<uint8_t>(e->kind));
+            put<int32_t>(e->line);
+            switch (e->kind)
+            {
+            case NodeKind::LITERAL:
+            {
+                auto lit = static_cast<const LiteralExpr *>(e);
+                put<uint8_t>(static_cast<uint8_t>(lit->litKind));
+                if (lit->litKind == LiteralExpr::Kind::INTEGER)
+                    put<ll>(lit->ival);
+                else if (lit->litKind == LiteralExpr::Kind::FLOAT)
+                    put<double>(lit->dval);
+                else if (lit->litKind == LiteralExpr::Kind::STRING)
+                    put<Symbol>(lit->sval);
+                else
+                    put<uint8_t>(lit->bval);
+                break;
+            }
+            case NodeKind::IDENT:
+            {
+                auto id = static_cast<const IdentExpr *>(e);
+                put<Symbol>(id->name);
+                binding(id->binding);
+                break;
+            }
+            case NodeKind::UNARY:
+            {
+                auto u = static_cast<const UnaryExpr *>(e);
+                put<uint8_t>(static_cast<uint8_t>(u->op));
+                expr(u->rhs.get());
+                break;
+            }
+            case NodeKind::BINARY:
+            {
+                auto b = static_cast<const BinaryExpr *>(e);
+                put<uint8_t>(static_cast<uint8_t>(b->op));
+                expr(b->lhs.get());
+                expr(b->rhs.get());
+                break;
+            }
+            case NodeKind::CALL:
+            {
+                auto c = static_cast<const CallExpr *>(e);
+                expr(c->callee.get());
+                put<uint32_t>(static_cast<uint32_t>(c->args.size()));
+                for (auto &arg : c->args)
+                    expr(arg.get());
+                break;
+            }
+            case NodeKind::ACCESS:
+            {
+                auto a = static_cast<const AccessExpr *>(e);
+                expr(a->target.get());
+                put<Symbol>(a->member);
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown expression node");
+            }
+        }
+
+        void body(const std::vector<StmtPtr> &stmts)
+        {
+            put<uint32_t>(static_cast<uint32_t>(stmts.size()));
+            for (auto &st : stmts)
+                stmt(st.get());
+        }
+
+        void stmt(const Stmt *s)
+        {
+            put<uint8_t>(static_cast<uint8_t>(s->kind));
+            put<int32_t>(s->line);
+            switch (s->kind)
+            {
+            case NodeKind::EXPR_STMT:
+                expr(static_cast<const ExprStmt *>(s)->expr.get());
+                break;
+            case NodeKind::ASSIGN:
+            {
+                auto as = static_cast<const AssignStmt *>(s);
+                put<Symbol>(as->name);
+                expr(as->expr.get());
+                binding(as->binding);
+                break;
+            }
+            case NodeKind::DECL:
+            {
+                auto ds = static_cast<const DeclStmt *>(s);
+                str(ds->type);
+                put<Symbol>(ds->name);
+                put<int32_t>(ds->slot);
+                put<uint8_t>(ds->init.has_value());
+                if (ds->init.has_value())
+                    expr(ds->init->get());
+                put<int32_t>(ds->initSlots);
+                body(ds->initBlock);
+                binding(ds->result);
+                break;
+            }
+            case NodeKind::IF:
+            {
+                auto is = static_cast<const IfStmt *>(s);
+                expr(is->cond.get());
+                put<int32_t>(is->thenSlots);
+                body(is->thenBody);
+                put<uint32_t>(static_cast<uint32_t>(is->elifs.size()));
+                for (size_t i = 0; i < is->elifs.size(); ++i)
+                {
+                    expr(is->elifs[i].first.get());
+                    put<int32_t>(i < is->elifSlots.size() ? is->elifSlots[i] : 0);
+                    body(is->elifs[i].second);
+                }
+                put<int32_t>(is->elseSlots);
+                body(is->elseBody);
+                break;
+            }
+            case NodeKind::FOR:
+            {
+                auto fs = static_cast<const ForStmt *>(s);
+                put<Symbol>(fs->iter);
+                put<uint32_t>(static_cast<uint32_t>(fs->args.size()));
+                for (auto &arg : fs->args)
+                    expr(arg.get());
+                put<int32_t>(fs->iterSlot);
+                put<int32_t>(fs->bodySlots);
+                body(fs->body);
+                break;
+            }
+            case NodeKind::OBJ:
+            {
+                auto os = static_cast<const ObjStmt *>(s);
+                put<Symbol>(os->className);
+                expr(os->idExpr.get());
+                put<int32_t>(os->bodySlots);
+                body(os->body);
+                break;
+            }
+            case NodeKind::BREAK:
+                body(static_cast<const BreakStmt *>(s)->body);
+                break;
+            case NodeKind::CONTINUE:
+                body(static_cast<const ContinueStmt *>(s)->body);
+                break;
+            default:
+                throw std::runtime_error("Unknown statement node");
+            }
+        }
+
+    private:
+        std::string &out;
+    };
+
+    // Bounds-checked reader over a mapped cache file
+    // Scope sizes are read before the nodes inside the scope, so every slot a binding names is
+    // checked against the frame it will index at runtime
+    class Reader
+    {
+    public:
+        Reader(std::string_view data, Arena *arena, size_t symbols) : data(data), arena(arena), symbols(symbols) {}
+
+        template <class T>
+        T get()
+        {
+            need(sizeof(T));
+            T v;
+            std::memcpy(&v, data.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return v;
+        }
+        std::string_view str()
+        {
+            uint32_t n = get<uint32_t>();
+            need(n);
+            std::string_view s = data.substr(pos, n);
+            pos += n;
+            return s;
+        }
+        uint32_t count()
+        {
+            // Every element takes at least one byte, which bounds bogus counts
+            uint32_t n = get<uint32_t>();
+            need(n);
+            return n;
+        }
+        Symbol symbol()
+        {
+            Symbol s = get<Symbol>();
+            if (s >= symbols)
+                corrupt();
+            return s;
+        }
+        bool atEnd() const { return pos == data.size(); }
+        std::string_view rest() const { return data.substr(pos); }
+        void setSymbols(size_t n) { symbols = n; }
+
+        // Slot count of a scope; a scope holds each name at most once
+        int scopeSize()
+        {
+            int n = get<int32_t>();
+            if (n < 0 || static_cast<size_t>(n) > symbols)
+                corrupt();
+            return n;
+        }
+        void openScope(int size) { scopes.push_back(size); }
+        void closeScope() { scopes.pop_back(); }
+
+        // Slot in the innermost scope; -1 (none) only inside an object, where names become fields
+        int localSlot()
+        {
+            int slot = get<int32_t>();
+            if (slot == -1 && objectDepth > 0)
+                return slot;
+            if (scopes.empty() || slot < 0 || slot >= scopes.back())
+                corrupt();
+            return slot;
+        }
+
+        VarBinding binding()
+        {
+            VarBinding b;
+            uint32_t n = count();
+            b.candidates.reserve(n);
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                int depth = get<int32_t>();
+                int index = get<int32_t>();
+                if (depth < 0 || static_cast<size_t>(depth) >= scopes.size() || index < 0 || index >= scopes[depth])
+                    corrupt();
+                b.candidates.push_back(Slot{depth, index});
+            }
+            b.own = get<int32_t>();
+            if (b.own < -1 || b.own >= (scopes.empty() ? 0 : scopes.back()))
+                corrupt();
+            return b;
+        }
+
+        ExprPtr expr()
+        {
+            auto kind = static_cast<NodeKind>(get<uint8_t>());
+            int line = get<int32_t>();
+            switch (kind)
+            {
+            case NodeKind::LITERAL:
+            {
+                auto litKind = static_cast<LiteralExpr::Kind>(get<uint8_t>());
+                if (litKind == LiteralExpr::Kind::INTEGER)
+                    return makeNode<LiteralExpr>(arena, get<ll>(), line);
+                if (litKind == LiteralExpr::Kind::FLOAT)
+                    return makeNode<LiteralExpr>(arena, get<double>(), line);
+                if (litKind == LiteralExpr::Kind::STRING)
+                    return makeNode<LiteralExpr>(arena, symbol(), line);
+                if (litKind == LiteralExpr::Kind::BOOL)
+                    return makeNode<LiteralExpr>(arena, get<uint8_t>() != 0, line);
+                break;
+            }
+            case NodeKind::IDENT:
+            {
+                auto id = makeNode<IdentExpr>(arena, symbol(), line);
+                id->binding = binding();
+                return id;
+            }
+            case NodeKind::UNARY:
+            {
+                auto op = static_cast<UnaryOp>(get<uint8_t>());
+                if (op != UnaryOp::NEG && op != UnaryOp::NOT)
+                    break;
+                return makeNode<UnaryExpr>(arena, op, expr(), line);
+            }
+            case NodeKind::BINARY:
+            {
+                auto op = static_cast<BinaryOp>(get<uint8_t>());
+                if (op >= BinaryOp::COUNT)
+                    break;
+                ExprPtr lhs = expr();
+                ExprPtr rhs = expr();
+                return makeNode<BinaryExpr>(arena, std::move(lhs), op, std::move(rhs), line);
+            }
+            case NodeKind::CALL:
+            {
+                ExprPtr callee = expr();
+                std::vector<ExprPtr> args;
+                uint32_t n = count();
+                for (uint32_t i = 0; i < n; ++i)
+                    args.push_back(expr());
+                return makeNode<CallExpr>(arena, std::move(callee), std::move(args), line);
+            }
+            case NodeKind::ACCESS:
+            {
+                ExprPtr target = expr();
+                return makeNode<AccessExpr>(arena, std::move(target), symbol(), line);
+            }
+            default:
+                break;
+            }
+            corrupt();
+        }
+
+        std::vector<StmtPtr> scopedBody(int size)
+        {
+            openScope(size);
+            std::vector<StmtPtr> stmts = body();
+            closeScope();
+            return stmts;
+        }
+
+        std::vector<StmtPtr> body()
+        {
+            std::vector<StmtPtr> stmts;
+            uint32_t n = count();
+            stmts.reserve(n);
+            for (uint32_t i = 0; i < n; ++i)
+                stmts.push_back(stmt());
+            return stmts;
+        }
+
+        StmtPtr stmt()
+        {
+            auto kind = static_cast<NodeKind>(get<uint8_t>());
+            int line = get<int32_t>();
+            switch (kind)
+            {
+            case NodeKind::EXPR_STMT:
+                return makeNode<ExprStmt>(arena, expr(), line);
+            case NodeKind::ASSIGN:
+            {
+                Symbol name = symbol();
+                ExprPtr value = expr();
+                auto as = makeNode<AssignStmt>(arena, name, std::move(value), line);
+                as->binding = binding();
+                if (as->binding.own < 0 && objectDepth == 0)
+                    corrupt(); // outside objects an unset name is created in the current scope
+                return as;
+            }
+            case NodeKind::DECL:
+            {
+                std::string type(str());
+                Symbol name = symbol();
+                int slot = localSlot();
+                std::optional<ExprPtr> init;
+                if (get<uint8_t>())
+                    init = expr();
+                int initSlots = scopeSize();
+
+                // The result binding names a variable of the initializer block's scope
+                openScope(initSlots);
+                std::vector<StmtPtr> initBlock = body();
+                VarBinding result = binding();
+                closeScope();
+
+                NodePtr<DeclStmt> ds;
+                if (init.has_value())
+                {
+                    ds = makeNode<DeclStmt>(arena, std::move(type), name, std::move(init), line);
+                    ds->initBlock = std::move(initBlock);
+                }
+                else
+                    ds = makeNode<DeclStmt>(arena, std::move(type), name, std::move(initBlock), line);
+                ds->slot = slot;
+                ds->initSlots = initSlots;
+                ds->result = std::move(result);
+                return ds;
+            }
+            case NodeKind::IF:
+            {
+                auto is = makeNode<IfStmt>(arena, expr(), line);
+                is->thenSlots = scopeSize();
+                is->thenBody = scopedBody(is->thenSlots);
+                uint32_t n = count();
+                for (uint32_t i = 0; i < n; ++i)
+                {
+                    ExprPtr cond = expr();
+                    int slots = scopeSize();
+                    is->elifs.emplace_back(std::move(cond), scopedBody(slots));
+                    is->elifSlots.push_back(slots);
+                }
+                is->elseSlots = scopeSize();
+                is->elseBody = scopedBody(is->elseSlots);
+                return is;
+            }
+            case NodeKind::FOR:
+            {
+                auto fs = makeNode<ForStmt>(arena, symbol(), line);
+                uint32_t n = count();
+                if (n < 1 || n > 3)
+                    break;
+                for (uint32_t i = 0; i < n; ++i)
+                    fs->args.push_back(expr());
+                // The loop scope holds the iterator, so it is never empty
+                fs->iterSlot = get<int32_t>();
+                fs->bodySlots = scopeSize();
+                if (fs->iterSlot < 0 || fs->iterSlot >= fs->bodySlots)
+                    break;
+                fs->body = scopedBody(fs->bodySlots);
+                return fs;
+            }
+            case NodeKind::OBJ:
+            {
+                Symbol className = symbol();
+                auto os = makeNode<ObjStmt>(arena, className, expr(), line);
+                os->bodySlots = scopeSize();
+                ++objectDepth;
+                os->body = scopedBody(os->bodySlots);
+                --objectDepth;
+                return os;
+            }
+            case NodeKind::BREAK:
+                return makeNode<BreakStmt>(arena, body(), line);
+            case NodeKind::CONTINUE:
+                return makeNode<ContinueStmt>(arena, body(), line);
+            default:
+                break;
+            }
+            corrupt();
+        }
+
+    private:
+        std::string_view data;
+        size_t pos = 0;
+        Arena *arena;
+        size_t symbols;
+        std::vector<int> scopes; // slot counts of the enclosing scopes, outermost first
+        int objectDepth = 0;     // obj bodies enclosing the node being read
+
+        void need(size_t n) const
+        {
+            if (n > data.size() - pos)
+                corrupt();
+        }
+        [[noreturn]] static void corrupt()
+        {
+            throw std::runtime_error("Corrupt compiled-program cache");
+        }
+    };
+}
+
+void writeProgram(const Program &program, uint64_t sourceHash, uint64_t sourceSize, std::string &out)
+{
+    Writer w(out);
+    out.append(kMagic, 4);
+    w.put<uint32_t>(kFormat);
+    w.str(kCompilerVersion);
+    w.str(kSchema);
+    w.put<uint64_t>(sourceHash);
+    w.put<uint64_t>(sourceSize);
+    // Checksum of everything after it, filled in once the payload is written
+    size_t checksumAt = out.size();
+    w.put<uint64_t>(0);
+    size_t payloadAt = out.size();
+
+    // Symbols are indexes into the table, so interning the strings in order restores them
+    const StringTable &strings = *program.strings;
+    w.put<uint32_t>(static_cast<uint32_t>(strings.size()));
+    for (Symbol s = sym::COUNT; s < strings.size(); ++s)
+        w.str(strings.str(s));
+
+    w.put<int32_t>(program.globalSlots);
+    for (Symbol name : program.globalNames)
+        w.put<Symbol>(name);
+    w.body(program.stmts);
+
+    uint64_t checksum = ProgramCache::hashSource(std::string_view(out).substr(payloadAt));
+    std::memcpy(&out[checksumAt], &checksum, sizeof(checksum));
+}
+
+std::unique_ptr<Program> readProgram(std::string_view data, uint64_t sourceHash, uint64_t sourceSize)
+{
+    if (data.size() < 4 || std::memcmp(data.data(), kMagic, 4) != 0)
+        throw std::runtime_error("Not a compiled-program cache file");
+
+    auto program = std::make_unique<Program>();
+    program->arena = std::make_unique<Arena>();
+    program->strings = std::make_shared<StringTable>();
+    Reader r(data.substr(4), program->arena.get(), 0);
+
+    if (r.get<uint32_t>() != kFormat || r.str() != kCompilerVersion || r.str() != kSchema)
+        throw std::runtime_error("Compiled-program cache from another compiler version");
+    if (r.get<uint64_t>() != sourceHash || r.get<uint64_t>() != sourceSize)
+        throw std::runtime_error("Compiled-program cache of another source");
+    // A file damaged on disk fails here rather than producing a program that runs differently
+    uint64_t checksum = r.get<uint64_t>();
+    if (ProgramCache::hashSource(r.rest()) != checksum)
+        throw std::runtime_error("Corrupt compiled-program cache");
+
+    uint32_t symbols = r.get<uint32_t>();
+    for (Symbol s = sym::COUNT; s < symbols; ++s)
+    {
+        if (program->strings->intern(r.str()) != s)
+            throw std::runtime_error("Corrupt compiled-program cache");
+    }
+    r.setSymbols(symbols);
+
+    program->globalSlots = r.scopeSize();
+    program->globalNames.resize(program->globalSlots);
+    for (Symbol &name : program->globalNames)
+        name = r.symbol();
+    program->stmts = r.scopedBody(program->globalSlots);
+    if (!r.atEnd())
+        throw std::runtime_error("Corrupt compiled-program cache");
+    return program;
+}
+
+uint64_t ProgramCache::hashSource(std::string_view source)
+{
+    // 64-bit multiply-mix over 8-byte words, then the tail
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = source.size() * k;
+    size_t i = 0;
+    for (; i + 8 <= source.size(); i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, source.data() + i, 8);
+        h = (h ^ (w * k)) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 29;
+    }
+    for (; i < source.size(); ++i)
+        h = (h ^ static_cast<unsigned char>(source[i])) * 0x100000001B3ull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string ProgramCache::pathFor(std::string_view source) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.ldast", static_cast<unsigned long long>(hashSource(source)));
+    return (std::filesystem::path(dir) / name).string();
+}
+
+std::unique_ptr<Program> ProgramCache::load(std::string_view source) const
+{
+    SourceBuffer file;
+    if (!file.load(pathFor(source)))
+        return nullptr;
+    try
+    {
+        return readProgram(file.view(), hashSource(source), source.size());
+    }
+    catch (const std::exception &)
+    {
+        return nullptr; // stale or damaged entries are simply rebuilt
+    }
+}
+
+bool ProgramCache::store(std::string_view source, const Program &program) const
+{
+    std::string bytes;
+    writeProgram(program, hashSource(source), source.size(), bytes);
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return replaceFile(pathFor(source), bytes);
+}
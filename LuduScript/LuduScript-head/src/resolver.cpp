@@ -0,0 +1,204 @@
+#include "resolver.h"
+
+// Every name a block may create in its own scope gets a slot up front, so a variable
+// declared late in a loop body still has a home on the next iteration
+void Resolver::collectSlots(const std::vector<StmtPtr> &body, Scope &scope)
+{
+    for (auto &st : body)
+    {
+        const Symbol *name = nullptr;
+        if (st->kind == NodeKind::DECL)
+            name = &static_cast<DeclStmt *>(st.get())->name;
+        else if (st->kind == NodeKind::ASSIGN)
+            name = &static_cast<AssignStmt *>(st.get())->name;
+        else if (st->kind == NodeKind::BREAK)
+            collectSlots(static_cast<BreakStmt *>(st.get())->body, scope); // break/continue bodies share the scope
+        else if (st->kind == NodeKind::CONTINUE)
+            collectSlots(static_cast<ContinueStmt *>(st.get())->body, scope);
+
+        // Inside an object declarations and unresolved assignments become fields
+        if (name && objectDepth == 0)
+            scope.emplace(*name, static_cast<int>(scope.size()));
+    }
+}
+
+int Resolver::openScope(const std::vector<StmtPtr> &body, const Symbol *extra)
+{
+    Scope scope;
+    if (extra)
+        scope.emplace(*extra, 0);
+    collectSlots(body, scope);
+    scopes.push_back(std::move(scope));
+    return static_cast<int>(scopes.back().size());
+}
+
+void Resolver::closeScope()
+{
+    scopes.pop_back();
+}
+
+VarBinding Resolver::bind(Symbol name) const
+{
+    VarBinding b;
+    for (int d = int(scopes.size()) - 1; d >= 0; --d)
+    {
+        auto it = scopes[d].find(name);
+        if (it != scopes[d].end())
+            b.candidates.push_back(Slot{d, it->second});
+    }
+    auto own = scopes.back().find(name);
+    if (own != scopes.back().end())
+        b.own = own->second;
+    return b;
+}
+
+void Resolver::resolve(Program &program)
+{
+    scopes.clear();
+    objectDepth = 0;
+
+    // The global scope always exists
+    program.globalSlots = openScope(program.stmts);
+    program.globalNames.assign(program.globalSlots, 0);
+    for (auto &[name, slot] : scopes.back())
+        program.globalNames[slot] = name;
+    resolveBody(program.stmts);
+    closeScope();
+}
+
+void Resolver::resolveExpr(Expr *e)
+{
+    switch (e->kind)
+    {
+    case NodeKind::IDENT:
+    {
+        auto id = static_cast<IdentExpr *>(e);
+        id->binding = bind(id->name);
+        break;
+    }
+    case NodeKind::UNARY:
+        resolveExpr(static_cast<UnaryExpr *>(e)->rhs.get());
+        break;
+    case NodeKind::BINARY:
+        resolveExpr(static_cast<BinaryExpr *>(e)->lhs.get());
+        resolveExpr(static_cast<BinaryExpr *>(e)->rhs.get());
+        break;
+    case NodeKind::CALL:
+    {
+        auto c = static_cast<CallExpr *>(e);
+        resolveExpr(c->callee.get());
+        for (auto &arg : c->args)
+            resolveExpr(arg.get());
+        break;
+    }
+    case NodeKind::ACCESS:
+        resolveExpr(static_cast<AccessExpr *>(e)->target.get());
+        break;
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveStmt(Stmt *s)
+{
+    switch (s->kind)
+    {
+    case NodeKind::EXPR_STMT:
+        resolveExpr(static_cast<ExprStmt *>(s)->expr.get());
+        break;
+    case NodeKind::ASSIGN:
+    {
+        auto as = static_cast<AssignStmt *>(s);
+        resolveExpr(as->expr.get());
+        as->binding = bind(as->name);
+        break;
+    }
+    case NodeKind::DECL:
+        resolveDecl(static_cast<DeclStmt *>(s));
+        break;
+    case NodeKind::IF:
+    {
+        auto is = static_cast<IfStmt *>(s);
+        resolveExpr(is->cond.get());
+        is->thenSlots = resolveBlock(is->thenBody);
+        is->elifSlots.clear();
+        for (auto &elif : is->elifs)
+        {
+            resolveExpr(elif.first.get());
+            is->elifSlots.push_back(resolveBlock(elif.second));
+        }
+        is->elseSlots = resolveBlock(is->elseBody);
+        break;
+    }
+    case NodeKind::FOR:
+    {
+        auto fs = static_cast<ForStmt *>(s);
+        for (auto &arg : fs->args)
+            resolveExpr(arg.get());
+        // The body runs directly in the loop scope, which also holds the iterator
+        fs->bodySlots = openScope(fs->body, &fs->iter);
+        fs->iterSlot = scopes.back().at(fs->iter);
+        resolveBody(fs->body);
+        closeScope();
+        break;
+    }
+    case NodeKind::OBJ:
+    {
+        auto os = static_cast<ObjStmt *>(s);
+        resolveExpr(os->idExpr.get());
+        ++objectDepth;
+        os->bodySlots = resolveBlock(os->body);
+        --objectDepth;
+        break;
+    }
+    case NodeKind::BREAK:
+        resolveBody(static_cast<BreakStmt *>(s)->body);
+        break;
+    case NodeKind::CONTINUE:
+        resolveBody(static_cast<ContinueStmt *>(s)->body);
+        break;
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveBody(const std::vector<StmtPtr> &body)
+{
+    for (auto &st : body)
+        resolveStmt(st.get());
+}
+
+int Resolver::resolveBlock(const std::vector<StmtPtr> &body)
+{
+    int size = openScope(body);
+    resolveBody(body);
+    closeScope();
+    return size;
+}
+
+void Resolver::resolveDecl(DeclStmt *ds)
+{
+    // The declared name lives in the enclosing scope, not the initializer's
+    ds->slot = objectDepth == 0 ? bind(ds->name).own : -1;
+    ds->result = VarBinding();
+
+    if (ds->init.has_value())
+        resolveExpr(ds->init->get());
+
+    if (!ds->initBlock.empty())
+    {
+        ds->initSlots = openScope(ds->initBlock);
+        resolveBody(ds->initBlock);
+
+        // Without an expression the block falls back to its last declared variable
+        for (auto it = ds->initBlock.rbegin(); it != ds->initBlock.rend(); ++it)
+        {
+            if ((*it)->kind == NodeKind::DECL)
+            {
+                ds->result = bind(static_cast<DeclStmt *>(it->get())->name);
+                break;
+            }
+        }
+        closeScope();
+    }
+}
@@ -0,0 +1,76 @@
+#include "sink.h"
+#include "json_writer.h"
+
+ObjectSink::ObjectSink(std::ostream &o, Framing f, bool p, FieldOrder fo)
+    : out(o), framing(f), pretty(p && f == Framing::ARRAY), order(fo)
+{
+    buf.reserve(kFlushSize + 4096);
+}
+
+ObjectSink::~ObjectSink()
+{
+    // Whatever was produced before an error still reaches the stream
+    flush();
+}
+
+void ObjectSink::write(const ObjectView &obj, const StringTable &strings)
+{
+    if (!writer || writerStrings != &strings)
+    {
+        writer = std::make_unique<JsonWriter>(strings, pretty, order);
+        writerStrings = &strings;
+    }
+
+    // An object that fails to serialise (invalid UTF-8) leaves nothing behind, separator included,
+    // so the objects before it still form a valid array
+    size_t mark = buf.size();
+    try
+    {
+        // Pretty objects are written one level deep, the same layout as json::dump(2) on the whole array
+        if (framing == Framing::ARRAY)
+        {
+            if (pretty)
+                buf += objects == 0 ? "[\n  " : ",\n  ";
+            else
+                buf += objects == 0 ? '[' : ',';
+        }
+        writer->writeObject(buf, obj);
+    }
+    catch (...)
+    {
+        buf.resize(mark);
+        throw;
+    }
+    if (framing == Framing::NDJSON)
+        buf += '\n';
+    ++objects;
+
+    if (buf.size() >= kFlushSize)
+        flush();
+}
+
+void ObjectSink::finish()
+{
+    if (finished)
+        return;
+    finished = true;
+    if (framing == Framing::ARRAY)
+    {
+        if (objects == 0)
+            buf += "[]";
+        else
+            buf += pretty ? "\n]" : "]";
+        buf += '\n';
+    }
+    flush();
+    out.flush();
+}
+
+void ObjectSink::flush()
+{
+    if (!buf.empty())
+    {
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+}
@@ -0,0 +1,125 @@
+#include "source.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+SourceBuffer::SourceBuffer(std::string text) : owned(std::move(text))
+{
+    data = owned.data();
+    size = owned.size();
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+SourceBuffer &SourceBuffer::operator=(SourceBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        mapping = std::exchange(other.mapping, nullptr);
+        size = std::exchange(other.size, 0);
+        owned = std::move(other.owned);
+        // A short owned string may have moved out of the other object's inline storage
+        data = mapping ? std::exchange(other.data, "") : owned.data();
+        other.data = "";
+    }
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer()
+{
+    release();
+}
+
+void SourceBuffer::release()
+{
+#if !defined(_WIN32)
+    if (mapping)
+        munmap(mapping, size);
+#endif
+    mapping = nullptr;
+    data = "";
+    size = 0;
+    owned.clear();
+}
+
+bool SourceBuffer::load(const std::string &path)
+{
+    release();
+
+#if !defined(_WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            ::close(fd);
+            madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            mapping = p;
+            data = static_cast<const char *>(p);
+            size = static_cast<size_t>(st.st_size);
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    // Fallback: read the whole file into the owned string
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+        return false;
+    std::ostringstream ss;
+    ss << ifs.rdbuf();
+    owned = std::move(ss).str();
+    data = owned.data();
+    size = owned.size();
+    return true;
+}
+
+bool replaceFile(const std::string &path, std::string_view bytes)
+{
+#if defined(_WIN32)
+    long pid = _getpid();
+#else
+    long pid = static_cast<long>(getpid());
+#endif
+    std::string tmp = path + ".tmp" + std::to_string(pid) + "-" +
+                      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        if (!ofs || !ofs.write(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+        {
+            ofs.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,232 @@
+#include "vm.h"
+#include <stdexcept>
+
+Value *VM::findVar(const BytecodeProgram &p, const VarRef &ref)
+{
+    return env.findVar(p.candidates.data() + ref.first, ref.count);
+}
+
+void VM::execute(const BytecodeProgram &program)
+{
+    stack.clear();
+    loops.clear();
+    env.strings = program.strings.get();
+    env.pushScope(program.globalSlots);
+
+    size_t pc = 0;
+    try
+    {
+        run(program, pc);
+    }
+    catch (const std::exception &ex)
+    {
+        // Errors raised by an expression statement are reported with its line, like the tree walker
+        for (auto &r : program.errorRanges)
+        {
+            if (pc >= r.begin && pc < r.end)
+                throw std::runtime_error(std::string("Runtime error (line ") + std::to_string(r.line) + "): " + ex.what());
+        }
+        throw;
+    }
+}
+
+std::string VM::getOutput(bool pretty) const
+{
+    return env.serialize(pretty);
+}
+
+void VM::run(const BytecodeProgram &p, size_t &pc)
+{
+    const Instr *code = p.code.data();
+
+#define BINARY_OP(fn)                                 \
+    {                                                 \
+        Value r = std::move(stack.back());            \
+        stack.pop_back();                             \
+        stack.back() = fn(stack.back(), r);           \
+        break;                                        \
+    }
+
+    while (true)
+    {
+        const Instr &in = code[pc];
+        switch (in.op)
+        {
+        case OpCode::CONST:
+            stack.push_back(p.consts[in.a]);
+            break;
+        case OpCode::LOAD:
+        {
+            const VarRef &ref = p.refs[in.a];
+            if (Value *v = findVar(p, ref))
+            {
+                stack.push_back(*v);
+                break;
+            }
+            // If in object context, fall back to the field value (or the field name itself)
+            auto field = env.lookupField(ref.name);
+            if (!field.has_value())
+                throw std::runtime_error("Undefined variable: " + p.strings->str(ref.name));
+            stack.push_back(std::move(*field));
+            break;
+        }
+        case OpCode::STORE:
+        {
+            const VarRef &ref = p.refs[in.a];
+            if (Value *v = findVar(p, ref))
+                *v = std::move(stack.back());
+            else if (env.inObject())
+                env.assignField(ref.name, stack.back());
+            else
+                env.setLocal(ref.ownSlot, std::move(stack.back()));
+            stack.pop_back();
+            break;
+        }
+        case OpCode::DECL:
+        {
+            const VarRef &ref = p.refs[in.a];
+            if (env.inObject())
+                env.declareField(ref.name, stack.back());
+            else
+                env.setLocal(ref.ownSlot, std::move(stack.back()));
+            stack.pop_back();
+            break;
+        }
+        case OpCode::LOAD_IF_SET:
+            if (Value *v = findVar(p, p.refs[in.a]))
+                stack.back() = *v;
+            break;
+        case OpCode::POP:
+            stack.pop_back();
+            break;
+        case OpCode::REPLACE:
+        {
+            Value v = std::move(stack.back());
+            stack.pop_back();
+            stack.back() = std::move(v);
+            break;
+        }
+        case OpCode::NEG:
+            stack.back() = ops::negate(stack.back());
+            break;
+        case OpCode::NOT:
+            stack.back() = ops::logicalNot(stack.back());
+            break;
+        case OpCode::ADD:
+            BINARY_OP(ops::add)
+        case OpCode::SUB:
+            BINARY_OP(ops::sub)
+        case OpCode::MUL:
+            BINARY_OP(ops::mul)
+        case OpCode::DIV:
+            BINARY_OP(ops::div)
+        case OpCode::MOD:
+            BINARY_OP(ops::mod)
+        case OpCode::EQ:
+            BINARY_OP(ops::eq)
+        case OpCode::NEQ:
+            BINARY_OP(ops::neq)
+        case OpCode::LT:
+            BINARY_OP(ops::lt)
+        case OpCode::GT:
+            BINARY_OP(ops::gt)
+        case OpCode::LE:
+            BINARY_OP(ops::le)
+        case OpCode::GE:
+            BINARY_OP(ops::ge)
+        case OpCode::TO_BOOL:
+            stack.back() = Value::makeBool(stack.back().toBool());
+            break;
+        case OpCode::JUMP:
+            pc = in.a;
+            continue;
+        case OpCode::JUMP_IF_FALSE:
+        {
+            bool cond = stack.back().toBool();
+            stack.pop_back();
+            if (!cond)
+            {
+                pc = in.a;
+                continue;
+            }
+            break;
+        }
+        case OpCode::AND_JUMP:
+        case OpCode::OR_JUMP:
+        {
+            bool cond = stack.back().toBool();
+            if (cond == (in.op == OpCode::OR_JUMP))
+            {
+                stack.back() = Value::makeBool(cond);
+                pc = in.a;
+                continue;
+            }
+            stack.pop_back();
+            break;
+        }
+        case OpCode::PUSH_SCOPE:
+            env.pushScope(in.a);
+            break;
+        case OpCode::POP_SCOPE:
+            env.popScope();
+            break;
+        case OpCode::FOR_PREP:
+        {
+            // for(i, N) / for(i, start, end) / for(i, start, end, step)
+            LoopState loop{1, 1, 1};
+            size_t base = stack.size() - in.a;
+            if (in.a == 1)
+            {
+                loop.end = stack[base].toInt();
+            }
+            else
+            {
+                loop.cur = stack[base].toInt();
+                loop.end = stack[base + 1].toInt();
+                if (in.a == 3)
+                    loop.step = stack[base + 2].toInt();
+            }
+            if (loop.step == 0)
+                loop.step = 1;
+            stack.resize(base);
+            loops.push_back(loop);
+            break;
+        }
+        case OpCode::FOR_NEXT:
+        {
+            LoopState &loop = loops.back();
+            if (loop.step > 0 ? loop.cur > loop.end : loop.cur < loop.end)
+            {
+                pc = in.b;
+                continue;
+            }
+            env.setLocal(in.a, Value::makeInt(loop.cur));
+            loop.cur += loop.step;
+            break;
+        }
+        case OpCode::FOR_END:
+            loops.pop_back();
+            break;
+        case OpCode::OBJ_BEGIN:
+            env.beginObject(static_cast<Symbol>(in.a));
+            break;
+        case OpCode::OBJ_ID:
+            env.setObjectId(stack.back());
+            stack.pop_back();
+            break;
+        case OpCode::OBJ_END:
+            env.endObject();
+            break;
+        case OpCode::OBJ_ABORT:
+            env.abortObject();
+            break;
+        case OpCode::FAIL:
+            throw std::runtime_error(p.messages[in.a]);
+        case OpCode::HALT:
+            return;
+        }
+        ++pc;
+    }
+
+#undef BINARY_OP
+}
@@ -0,0 +1,39 @@
+# 用法: cmake -DBIN=<luduscript> -DSCRIPT=<x.gen> -DMODE=jobs|incremental|compile-cache -DWORK=<目录> -P compare_modes.cmake
+# 以单线程、无缓存的运行结果为准，检查同一脚本在 MODE 下的标准输出与退出码是否完全一致
+
+execute_process(COMMAND ${BIN} ${SCRIPT}
+    OUTPUT_VARIABLE expected RESULT_VARIABLE expected_rc ERROR_QUIET)
+
+if(MODE STREQUAL "jobs")
+    set(runs "--jobs;4")
+elseif(MODE STREQUAL "incremental")
+    # 第一次运行写入缓存，第二次运行从缓存回放
+    get_filename_component(name ${SCRIPT} NAME_WE)
+    set(cache ${WORK}/${name}.ldcache)
+    file(MAKE_DIRECTORY ${WORK})
+    file(REMOVE ${cache})
+    set(runs "--incremental=${cache}")
+elseif(MODE STREQUAL "compile-cache")
+    # 第一次运行写入编译结果，第二次运行从缓存加载语法树
+    get_filename_component(name ${SCRIPT} NAME_WE)
+    set(cache ${WORK}/${name}.ldast.d)
+    file(REMOVE_RECURSE ${cache})
+    set(runs "--compile-cache;${cache}")
+else()
+    message(FATAL_ERROR "Unknown MODE ${MODE}")
+endif()
+
+set(passes 1)
+if(MODE STREQUAL "incremental" OR MODE STREQUAL "compile-cache")
+    set(passes 2)
+endif()
+foreach(pass RANGE 1 ${passes})
+    execute_process(COMMAND ${BIN} ${SCRIPT} ${runs}
+        OUTPUT_VARIABLE actual RESULT_VARIABLE actual_rc ERROR_VARIABLE actual_err)
+    if(NOT actual_rc STREQUAL expected_rc)
+        message(FATAL_ERROR "${MODE} run ${pass}: exit code ${actual_rc}, expected ${expected_rc}\n${actual_err}")
+    endif()
+    if(NOT actual STREQUAL expected)
+        message(FATAL_ERROR "${MODE} run ${pass}: output differs from the sequential run\n--- expected\n${expected}\n--- actual\n${actual}")
+    endif()
+endforeach()